@@ -5,16 +5,17 @@ Tests how execution time changes with increasing number of processors
 while keeping problem size constant (4096x4096)
 """
 
-import subprocess
-import time
 import json
 import os
 import sys
 from datetime import datetime
 import csv
 
+from sweep import SweepOrchestrator
+
 def run_scaling_test(executable, num_processors_list, matrix_size=4096, 
-                     num_threads=4, test_name="strong_scaling"):
+                     num_threads=4, test_name="strong_scaling", repeats=3,
+                     sweep_name=None):
     """
     Run strong scaling analysis
     
@@ -24,6 +25,8 @@ def run_scaling_test(executable, num_processors_list, matrix_size=4096,
         matrix_size: Size of the matrix (constant for strong scaling)
         num_threads: Number of OpenMP threads per process
         test_name: Name for the test run
+        repeats: Runs per processor count; the median is reported
+        sweep_name: Existing sweep under results/sweeps to resume
     """
     
     results_dir = "results/scaling"
@@ -46,97 +49,53 @@ def run_scaling_test(executable, num_processors_list, matrix_size=4096,
     print(f"Testing with processors: {num_processors_list}")
     print("="*70)
     
-    # Determine if C++ or Python
-    is_python = executable.endswith('.py')
-    
+    # Independent processor counts run concurrently on disjoint cores
+    if not sweep_name:
+        sweep_name = f"{test_name}_{datetime.now().strftime('%Y%m%d_%H%M%S')}"
+    orchestrator = SweepOrchestrator(executable, sweep_name=sweep_name,
+                                     repeats=repeats, timeout=600)
     for num_procs in num_processors_list:
-        print(f"\n[Test] Running with {num_procs} processor(s)...")
-        
-        # Build command
-        if is_python:
-            cmd = [
-                "mpirun",
-                "-np", str(num_procs),
-                "python3", executable
-            ]
-        else:
-            cmd = [
-                "mpirun",
-                "-np", str(num_procs),
-                executable,
-                str(num_threads)
-            ]
-        
-        # Run test
-        start_time = time.time()
+        orchestrator.add_config(num_procs, num_threads)
+    summary = orchestrator.run()
+    
+    for entry in summary:
+        num_procs = entry["num_procs"]
         
-        try:
-            result = subprocess.run(
-                cmd,
-                capture_output=True,
-                text=True,
-                timeout=600  # 10 minute timeout
-            )
-            
-            elapsed_time = time.time() - start_time
-            
-            # Parse output for actual computation time
-            output_lines = result.stdout.split('\n')
-            computation_time = elapsed_time  # Default to wall time
-            
-            for line in output_lines:
-                if "Completed in" in line or "seconds" in line:
-                    # Try to extract time from output
-                    try:
-                        words = line.split()
-                        for i, word in enumerate(words):
-                            if word == "in" and i+1 < len(words):
-                                computation_time = float(words[i+1])
-                                break
-                    except:
-                        pass
-            
-            print(f"   ✓ Completed in {computation_time:.4f} seconds")
+        if entry["success"]:
+            computation_time = entry["time"]
             
             # Calculate metrics
-            speedup = results["measurements"][0]["time"] / computation_time if results["measurements"] else 1.0
+            base = next((m for m in results["measurements"] if m["success"]), None)
+            speedup = base["time"] / computation_time if base else 1.0
             efficiency = (speedup / num_procs) * 100 if num_procs > 0 else 0
             
             measurement = {
                 "num_processors": num_procs,
                 "time": computation_time,
+                "time_std": entry["time_std"],
+                "repeats": entry["repeats"],
                 "speedup": speedup,
                 "efficiency": efficiency,
-                "wall_time": elapsed_time,
                 "success": True
             }
             
+            print(f"\n[{num_procs} processor(s)] {computation_time:.4f} s "
+                  f"(median of {entry['repeats']}, std {entry['time_std']:.4f})")
             print(f"   Speedup: {speedup:.2f}x")
             print(f"   Efficiency: {efficiency:.2f}%")
-            
-        except subprocess.TimeoutExpired:
-            print(f"   ✗ Timeout after 10 minutes")
-            measurement = {
-                "num_processors": num_procs,
-                "time": None,
-                "speedup": None,
-                "efficiency": None,
-                "success": False,
-                "error": "timeout"
-            }
-        except Exception as e:
-            print(f"   ✗ Error: {str(e)}")
+        else:
+            print(f"\n[{num_procs} processor(s)] ✗ all runs failed "
+                  f"(see {orchestrator.sweep_dir})")
             measurement = {
                 "num_processors": num_procs,
                 "time": None,
                 "speedup": None,
                 "efficiency": None,
                 "success": False,
-                "error": str(e)
+                "error": "all runs failed"
             }
         
         results["measurements"].append(measurement)
-        time.sleep(2)  # Brief pause between tests
     
     # Save results
     timestamp_str = datetime.now().strftime("%Y%m%d_%H%M%S")
@@ -186,12 +145,16 @@ def print_summary(results):
 
 def main():
     if len(sys.argv) < 2:
-        print("Usage: python3 strong_scaling.py <executable>")
+        print("Usage: python3 strong_scaling.py <executable> [--resume=<sweep_name>]")
         print("Example: python3 strong_scaling.py ./bin/matrix_operations_mpi")
         print("Example: python3 strong_scaling.py src/matrix_operations_python.py")
         sys.exit(1)
     
     executable = sys.argv[1]
+    sweep_name = None
+    for arg in sys.argv[2:]:
+        if arg.startswith("--resume="):
+            sweep_name = arg[len("--resume="):]
     
     if not os.path.exists(executable):
         print(f"Error: Executable not found: {executable}")
@@ -206,7 +169,8 @@ def main():
         num_processors_list=num_processors_list,
         matrix_size=4096,
         num_threads=4,
-        test_name="strong_scaling_4096"
+        test_name="strong_scaling_4096",
+        sweep_name=sweep_name
     )
     
     print_summary(results)
@@ -0,0 +1,368 @@
+#!/usr/bin/env python3
+"""
+Scaling Sweep Orchestrator
+Runs independent configurations concurrently on disjoint core sets,
+repeats each one for statistics and resumes interrupted sweeps
+"""
+
+import subprocess
+import time
+import json
+import os
+import sys
+import signal
+import statistics
+from datetime import datetime
+
+
+def available_cores():
+    """Cores this process may run on"""
+    try:
+        return sorted(os.sched_getaffinity(0))
+    except AttributeError:
+        return list(range(os.cpu_count() or 1))
+
+
+def parse_core_list(text):
+    """Parse '0-3,8,10-11' into a list of core ids"""
+    cores = []
+    for part in text.split(','):
+        if '-' in part:
+            lo, hi = part.split('-')
+            cores.extend(range(int(lo), int(hi) + 1))
+        elif part:
+            cores.append(int(part))
+    return cores
+
+
+def parse_stdout_time(stdout):
+    """Fallback for engines without --json: first 'Completed in <t>' line"""
+    for line in stdout.split('\n'):
+        if "Completed in" in line:
+            words = line.split()
+            for i, word in enumerate(words):
+                if word == "in" and i + 1 < len(words):
+                    try:
+                        return float(words[i + 1])
+                    except ValueError:
+                        pass
+    return None
+
+
+class SweepJob:
+    """One run of one configuration"""
+
+    def __init__(self, config, repeat):
+        self.config = config
+        self.repeat = repeat
+        self.key = f"{config['name']}_r{repeat}"
+        self.cores_needed = config['num_procs'] * config['num_threads']
+        self.cores = []
+        self.process = None
+        self.start_time = None
+        self.run_dir = None
+        self.log = None
+
+
+class SweepOrchestrator:
+    """
+    Pack independent engine runs onto non-overlapping core sets
+
+    Each run gets its own working directory (so data/ and results/ written
+    by the engine never collide) and writes its timings with --json. Finished
+    runs are appended to completed.jsonl; re-running a sweep with the same
+    name skips everything already recorded there.
+    """
+
+    def __init__(self, executable, sweep_name=None, results_dir="results/sweeps",
+                 repeats=3, timeout=600, cores=None, max_concurrent=None,
+                 mpirun_args=None):
+        self.executable = os.path.abspath(executable)
+        self.is_python = executable.endswith('.py')
+        self.sweep_name = sweep_name or datetime.now().strftime("sweep_%Y%m%d_%H%M%S")
+        self.sweep_dir = os.path.join(results_dir, self.sweep_name)
+        self.state_file = os.path.join(self.sweep_dir, "completed.jsonl")
+        self.repeats = repeats
+        self.timeout = timeout
+        self.cores = cores if cores else available_cores()
+        self.max_concurrent = max_concurrent
+        if mpirun_args is None:
+            mpirun_args = os.environ.get("MPIRUN_ARGS", "").split()
+        self.mpirun_args = mpirun_args
+        self.configs = []
+        os.makedirs(self.sweep_dir, exist_ok=True)
+
+    def add_config(self, num_procs, num_threads=1, args=None):
+        """Register a configuration; args are extra engine arguments"""
+        args = list(args or [])
+        name = f"p{num_procs}_t{num_threads}"
+        if args:
+            name += "_" + "_".join(a.lstrip('-').replace('=', '-') for a in args)
+        self.configs.append({
+            "name": name,
+            "num_procs": num_procs,
+            "num_threads": num_threads,
+            "args": args,
+        })
+
+    def _load_completed(self):
+        completed = {}
+        if os.path.exists(self.state_file):
+            with open(self.state_file, 'r') as f:
+                for line in f:
+                    line = line.strip()
+                    if not line:
+                        continue
+                    try:
+                        record = json.loads(line)
+                    except ValueError:
+                        continue  # Truncated by an interruption
+                    if record.get("success"):
+                        completed[record["key"]] = record
+        return completed
+
+    def _record(self, record):
+        with open(self.state_file, 'a') as f:
+            f.write(json.dumps(record) + "\n")
+            f.flush()
+            os.fsync(f.fileno())
+
+    def _build_command(self, job, exclusive):
+        cfg = job.config
+        cmd = ["mpirun", "-np", str(cfg['num_procs'])] + self.mpirun_args
+        if exclusive:
+            cmd += ["--oversubscribe"]
+        else:
+            cmd += ["--cpu-set", ",".join(str(c) for c in job.cores), "--bind-to", "core"]
+            if cfg['num_threads'] > 1:
+                cmd += ["--map-by", f"slot:PE={cfg['num_threads']}"]
+        if self.is_python:
+            cmd += ["python3", self.executable]
+        else:
+            cmd += [self.executable, str(cfg['num_threads']), "--json=run.json"]
+        return cmd + cfg['args']
+
+    def _start(self, job, exclusive=False):
+        cfg = job.config
+        job.run_dir = os.path.abspath(os.path.join(self.sweep_dir, job.key))
+        for sub in ("data", "results", "results/monitoring", "results/scaling"):
+            os.makedirs(os.path.join(job.run_dir, sub), exist_ok=True)
+        stale = os.path.join(job.run_dir, "run.json")
+        if os.path.exists(stale):
+            os.remove(stale)  # Left by an interrupted attempt
+
+        env = dict(os.environ)
+        env["OMP_NUM_THREADS"] = str(cfg['num_threads'])
+        cmd = self._build_command(job, exclusive)
+        job.log = open(os.path.join(job.run_dir, "stdout.log"), 'w')
+        job.process = subprocess.Popen(cmd, cwd=job.run_dir, env=env, stdout=job.log,
+                                       stderr=subprocess.STDOUT, start_new_session=True)
+        job.start_time = time.time()
+        where = "exclusive" if exclusive else f"cores {job.cores[0]}-{job.cores[-1]}"
+        print(f"   ▶ {job.key} ({where})")
+
+    def _finish(self, job, error=None):
+        wall_time = time.time() - job.start_time
+        job.log.close()
+        cfg = job.config
+
+        engine = None
+        json_path = os.path.join(job.run_dir, "run.json")
+        if os.path.exists(json_path):
+            try:
+                with open(json_path, 'r') as f:
+                    engine = json.load(f)
+            except ValueError:
+                engine = None
+
+        if engine is not None:
+            run_time = engine.get("multiply_time")
+        else:
+            with open(os.path.join(job.run_dir, "stdout.log"), 'r') as f:
+                run_time = parse_stdout_time(f.read())
+
+        success = error is None and job.process.returncode == 0 and run_time is not None
+        if error is None and not success:
+            error = f"exit code {job.process.returncode}"
+
+        record = {
+            "key": job.key,
+            "config": cfg['name'],
+            "num_procs": cfg['num_procs'],
+            "num_threads": cfg['num_threads'],
+            "repeat": job.repeat,
+            "cores": job.cores,
+            "time": run_time,
+            "wall_time": wall_time,
+            "engine": engine,
+            "success": success,
+        }
+        if error:
+            record["error"] = error
+        self._record(record)
+
+        status = f"{run_time:.4f} s" if success else f"failed ({error})"
+        print(f"   ■ {job.key}: {status}")
+        return record
+
+    def _kill(self, job):
+        try:
+            os.killpg(job.process.pid, signal.SIGTERM)
+            job.process.wait(timeout=10)
+        except (ProcessLookupError, subprocess.TimeoutExpired):
+            try:
+                os.killpg(job.process.pid, signal.SIGKILL)
+            except ProcessLookupError:
+                pass
+            job.process.wait()
+
+    def run(self):
+        """Run all pending jobs; returns per-configuration statistics"""
+        completed = self._load_completed()
+        jobs = [SweepJob(cfg, r) for cfg in self.configs for r in range(self.repeats)]
+        pending = [j for j in jobs if j.key not in completed]
+
+        # Largest first packs better; repeats interleave so an interruption
+        # still leaves every configuration with some samples
+        pending.sort(key=lambda j: (j.repeat, -j.cores_needed))
+
+        print("=" * 70)
+        print(f"Sweep: {self.sweep_name}")
+        print(f"Cores: {len(self.cores)}, jobs: {len(jobs)} "
+              f"({len(jobs) - len(pending)} already completed)")
+        print("=" * 70)
+
+        free = list(self.cores)
+        running = []
+
+        try:
+            while pending or running:
+                # Start every pending job that fits in the free cores
+                for job in list(pending):
+                    if self.max_concurrent and len(running) >= self.max_concurrent:
+                        break
+                    if job.cores_needed > len(self.cores):
+                        # Needs more than the machine: run alone, oversubscribed
+                        if not running:
+                            pending.remove(job)
+                            job.cores = list(self.cores)
+                            free = []
+                            self._start(job, exclusive=True)
+                            running.append(job)
+                        break
+                    if job.cores_needed <= len(free):
+                        pending.remove(job)
+                        job.cores = free[:job.cores_needed]
+                        free = free[job.cores_needed:]
+                        self._start(job)
+                        running.append(job)
+
+                time.sleep(0.2)
+
+                for job in list(running):
+                    error = None
+                    if job.process.poll() is None:
+                        if time.time() - job.start_time < self.timeout:
+                            continue
+                        self._kill(job)
+                        error = "timeout"
+                    running.remove(job)
+                    completed[job.key] = self._finish(job, error)
+                    free = sorted(free + job.cores)
+        except KeyboardInterrupt:
+            print("\nInterrupted; stopping running jobs (re-run to resume)")
+            for job in running:
+                self._kill(job)
+                job.log.close()
+            raise
+
+        return self.summarize(completed)
+
+    def summarize(self, completed=None):
+        """Aggregate successful repeats per configuration"""
+        if completed is None:
+            completed = self._load_completed()
+
+        summary = []
+        for cfg in self.configs:
+            records = [r for r in completed.values()
+                       if r.get("config") == cfg['name'] and r.get("success")]
+            times = [r["time"] for r in records]
+            entry = {
+                "config": cfg['name'],
+                "num_procs": cfg['num_procs'],
+                "num_threads": cfg['num_threads'],
+                "repeats": len(times),
+                "success": len(times) > 0,
+            }
+            if times:
+                entry.update({
+                    "time": statistics.median(times),
+                    "time_mean": statistics.mean(times),
+                    "time_std": statistics.stdev(times) if len(times) > 1 else 0.0,
+                    "time_min": min(times),
+                    "engine": records[0].get("engine"),
+                })
+            summary.append(entry)
+
+        with open(os.path.join(self.sweep_dir, "summary.json"), 'w') as f:
+            json.dump(summary, f, indent=2)
+        return summary
+
+
+def main():
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Concurrent scaling sweep",
+                                     epilog="Engine arguments follow '--'")
+    parser.add_argument("executable")
+    parser.add_argument("--procs", default="1,2,4,8", help="Process counts, e.g. 1,2,4,8")
+    parser.add_argument("--threads", type=int, default=1, help="OpenMP threads per process")
+    parser.add_argument("--repeats", type=int, default=3)
+    parser.add_argument("--timeout", type=int, default=600)
+    parser.add_argument("--cores", default="", help="Core ids to use, e.g. 0-15")
+    parser.add_argument("--max-concurrent", type=int, default=None)
+    parser.add_argument("--name", default=None, help="Sweep name; reuse it to resume")
+    # Everything after "--" goes to the engine
+    argv = sys.argv[1:]
+    engine_args = []
+    if "--" in argv:
+        engine_args = argv[argv.index("--") + 1:]
+        argv = argv[:argv.index("--")]
+    args = parser.parse_args(argv)
+
+    if not os.path.exists(args.executable):
+        print(f"Error: Executable not found: {args.executable}")
+        sys.exit(1)
+
+    orchestrator = SweepOrchestrator(
+        args.executable,
+        sweep_name=args.name,
+        repeats=args.repeats,
+        timeout=args.timeout,
+        cores=parse_core_list(args.cores) if args.cores else None,
+        max_concurrent=args.max_concurrent,
+    )
+    for num_procs in [int(p) for p in args.procs.split(',') if p]:
+        orchestrator.add_config(num_procs, args.threads, engine_args)
+
+    try:
+        summary = orchestrator.run()
+    except KeyboardInterrupt:
+        sys.exit(130)
+
+    print("\n" + "=" * 70)
+    print(f"{'Config':<24} {'Runs':<6} {'Median (s)':<12} {'Std (s)':<10}")
+    print("-" * 70)
+    for entry in summary:
+        if entry["success"]:
+            print(f"{entry['config']:<24} {entry['repeats']:<6} "
+                  f"{entry['time']:<12.4f} {entry['time_std']:<10.4f}")
+        else:
+            print(f"{entry['config']:<24} failed")
+    print("=" * 70)
+    print(f"Results: {orchestrator.sweep_dir}")
+
+
+if __name__ == "__main__":
+    main()
@@ -390,6 +390,79 @@ class PerformanceVisualizer:
         
         return output_file
     
+    def plot_model_vs_measured(self, model_file=None, log_file=None,
+                               multiply_algorithm="row_striped_distributed"):
+        """
+        Plot analytical model predictions (matrix_operations_mpi --model)
+        against measured times from the engine's performance log
+        """
+        if not model_file:
+            model_file = os.path.join(self.results_dir, "model_predictions.json")
+        if not log_file:
+            log_file = os.path.join(self.results_dir, "performance_log.csv")
+        
+        if not os.path.exists(model_file):
+            print(f"Model predictions not found: {model_file}")
+            return
+        
+        with open(model_file, 'r') as f:
+            model = json.load(f)
+        df_model = pd.DataFrame(model['predictions'])
+        
+        # Engine log rows: operation, processes, time, matrix size (no header)
+        operation_to_algorithm = {
+            'Matrix_Multiplication': multiply_algorithm,
+            'Matrix_Inversion': 'gauss_jordan_inverse',
+            'Log_Determinant': 'lu_logdet',
+        }
+        df_measured = pd.DataFrame(columns=['algorithm', 'procs', 'time'])
+        if os.path.exists(log_file):
+            df_log = pd.read_csv(log_file, header=None,
+                                 names=['operation', 'procs', 'time', 'matrix_size'])
+            df_log = df_log[df_log['operation'].isin(operation_to_algorithm.keys())]
+            df_log['procs'] = pd.to_numeric(df_log['procs'], errors='coerce')
+            df_log['time'] = pd.to_numeric(df_log['time'], errors='coerce')
+            df_log['algorithm'] = df_log['operation'].map(operation_to_algorithm)
+            df_measured = df_log.groupby(['algorithm', 'procs'], as_index=False)['time'].median()
+        
+        print(f"Plotting model vs measured from: {model_file}")
+        
+        algorithms = list(dict.fromkeys(operation_to_algorithm.values()))
+        fig, axes = plt.subplots(1, len(algorithms), figsize=(6 * len(algorithms), 5))
+        fig.suptitle('Analytical Model vs Measured Time', fontsize=16, fontweight='bold')
+        
+        for ax, algorithm in zip(axes, algorithms):
+            pred = df_model[df_model['algorithm'] == algorithm].sort_values('procs')
+            meas = df_measured[df_measured['algorithm'] == algorithm].sort_values('procs')
+            
+            if not pred.empty:
+                ax.plot(pred['procs'], pred['total_time'], 'o--', linewidth=2, markersize=6,
+                        color='#2E86AB', label='Predicted (total)')
+                ax.plot(pred['procs'], pred['comm_time'], ':', linewidth=1.5,
+                        color='#F18F01', label='Predicted (comm)')
+            if not meas.empty:
+                ax.plot(meas['procs'], meas['time'], 's-', linewidth=2, markersize=8,
+                        color='#A23B72', label='Measured')
+            
+            n = int(pred['n'].iloc[0]) if not pred.empty else 0
+            ax.set_xscale('log', base=2)
+            ax.set_yscale('log')
+            ax.set_xlabel('Number of Processors', fontweight='bold')
+            ax.set_ylabel('Time (seconds)', fontweight='bold')
+            ax.set_title(f'{algorithm} (n={n})')
+            ax.grid(True, alpha=0.3)
+            ax.legend()
+        
+        plt.tight_layout()
+        
+        output_file = os.path.join(self.output_dir, 'model_vs_measured.png')
+        plt.savefig(output_file, dpi=300, bbox_inches='tight')
+        print(f"✓ Model vs measured plot saved: {output_file}")
+        
+        plt.close()
+        
+        return output_file
+    
     def generate_report(self):
         """
         Generate comprehensive HTML report
@@ -421,6 +494,11 @@ class PerformanceVisualizer:
         except Exception as e:
             print(f"Warning: Could not generate monitoring plot: {e}")
         
+        try:
+            plots['model'] = self.plot_model_vs_measured()
+        except Exception as e:
+            print(f"Warning: Could not generate model plot: {e}")
+        
         print("\n" + "="*70)
         print("Report Generation Complete")
         print("="*70)
@@ -447,11 +525,13 @@ def main():
             visualizer.plot_communication_bottleneck()
         elif command == "monitoring":
             visualizer.plot_resource_monitoring()
+        elif command == "model":
+            visualizer.plot_model_vs_measured()
         elif command == "all" or command == "report":
             visualizer.generate_report()
         else:
             print(f"Unknown command: {command}")
-            print("Usage: python3 visualize.py [strong|weak|bottleneck|monitoring|all]")
+            print("Usage: python3 visualize.py [strong|weak|bottleneck|monitoring|model|all]")
     else:
         # Generate all plots
         visualizer.generate_report()
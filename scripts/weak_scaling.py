@@ -5,24 +5,29 @@ Tests how execution time changes when both problem size and number of processors
 increase proportionally (constant work per processor)
 """
 
-import subprocess
-import time
 import json
 import os
 import sys
 from datetime import datetime
 import csv
 
-def run_weak_scaling_test(executable_template, scaling_configs, 
-                          num_threads=4, test_name="weak_scaling"):
+from sweep import SweepOrchestrator
+
+def run_weak_scaling_test(executable, num_processors_list, base_size=2048,
+                          scale="memory", num_threads=4, test_name="weak_scaling",
+                          repeats=3, sweep_name=None):
     """
-    Run weak scaling analysis
+    Run weak scaling analysis with the engine's --weak mode
     
     Args:
-        executable_template: Path template to executable
-        scaling_configs: List of (num_processors, matrix_size) tuples
+        executable: Path to the C++ executable
+        num_processors_list: List of processor counts to test
+        base_size: Matrix size handled by one processor (the per-rank work)
+        scale: "memory" (n grows with sqrt(P)) or "flops" (n grows with cbrt(P))
         num_threads: Number of OpenMP threads per process
         test_name: Name for the test run
+        repeats: Runs per configuration; the median is reported
+        sweep_name: Existing sweep under results/sweeps to resume
     """
     
     results_dir = "results/scaling"
@@ -31,6 +36,8 @@ def run_weak_scaling_test(executable_template, scaling_configs,
     results = {
         "test_name": test_name,
         "test_type": "weak_scaling",
+        "base_size": base_size,
+        "scale": scale,
         "num_threads": num_threads,
         "timestamp": datetime.now().isoformat(),
         "measurements": []
@@ -40,109 +47,71 @@ def run_weak_scaling_test(executable_template, scaling_configs,
     print(f"Weak Scaling Analysis: {test_name}")
     print("="*70)
     print(f"OpenMP Threads per Process: {num_threads}")
-    print(f"Scaling: Constant work per processor")
+    print(f"Scaling: {base_size}x{base_size} per processor ({scale}-scaled)")
     print("="*70)
     
-    base_time = None
-    
-    for num_procs, matrix_size in scaling_configs:
-        print(f"\n[Test] {num_procs} processor(s), {matrix_size}x{matrix_size} matrix")
-        print(f"       Work per processor: {(matrix_size**2)/(num_procs):.0f} elements")
+    if not sweep_name:
+        sweep_name = f"{test_name}_{datetime.now().strftime('%Y%m%d_%H%M%S')}"
+    orchestrator = SweepOrchestrator(executable, sweep_name=sweep_name,
+                                     repeats=repeats, timeout=600)
+    weak_args = [f"--weak={base_size}", f"--weak-scale={scale}"]
+    
+    # The single-processor runs give the baseline the engine reports against
+    orchestrator.add_config(1, num_threads, weak_args)
+    baseline = orchestrator.run()[0]
+    if not baseline["success"]:
+        print(f"✗ Baseline run failed (see {orchestrator.sweep_dir})")
+        return results
+    
+    engine = baseline["engine"]
+    baseline_arg = f"--weak-baseline={baseline['time']},{engine['inverse_time']}"
+    
+    # Larger configurations run concurrently on disjoint cores
+    for num_procs in num_processors_list:
+        if num_procs > 1:
+            orchestrator.add_config(num_procs, num_threads, weak_args + [baseline_arg])
+    summary = orchestrator.run()
+    
+    for entry in summary:
+        num_procs = entry["num_procs"]
+        print(f"\n[{num_procs} processor(s)]")
         
-        # For Python script with dynamic matrix size, we need to modify approach
-        # This is a simplified version - actual implementation may need wrapper
-        executable = executable_template
-        is_python = executable.endswith('.py')
-        
-        # Build command
-        if is_python:
-            cmd = [
-                "mpirun",
-                "-np", str(num_procs),
-                "python3", executable
-            ]
-        else:
-            cmd = [
-                "mpirun",
-                "-np", str(num_procs),
-                executable,
-                str(num_threads)
-            ]
-        
-        # Run test
-        start_time = time.time()
-        
-        try:
-            result = subprocess.run(
-                cmd,
-                capture_output=True,
-                text=True,
-                timeout=600  # 10 minute timeout
-            )
-            
-            elapsed_time = time.time() - start_time
+        if entry["success"]:
+            engine = entry["engine"]
+            matrix_size = engine["matrix_size"]
+            computation_time = entry["time"]
+            efficiency = engine.get("multiply_efficiency", 1.0) * 100
             
-            # Parse output for actual computation time
-            output_lines = result.stdout.split('\n')
-            computation_time = elapsed_time
-            
-            for line in output_lines:
-                if "Completed in" in line or "seconds" in line:
-                    try:
-                        words = line.split()
-                        for i, word in enumerate(words):
-                            if word == "in" and i+1 < len(words):
-                                computation_time = float(words[i+1])
-                                break
-                    except:
-                        pass
-            
-            print(f"   ✓ Completed in {computation_time:.4f} seconds")
-            
-            # Set base time from first measurement
-            if base_time is None:
-                base_time = computation_time
-            
-            # Calculate efficiency (ideally stays constant in weak scaling)
-            efficiency = (base_time / computation_time) * 100 if computation_time > 0 else 0
+            print(f"   {matrix_size}x{matrix_size} matrix, "
+                  f"work per processor: {(matrix_size**2)/(num_procs):.0f} elements")
+            print(f"   Median of {entry['repeats']}: {computation_time:.4f} s "
+                  f"(std {entry['time_std']:.4f})")
+            print(f"   Weak Scaling Efficiency: {efficiency:.2f}%")
             
             measurement = {
                 "num_processors": num_procs,
                 "matrix_size": matrix_size,
                 "work_per_processor": (matrix_size**2) / num_procs,
                 "time": computation_time,
+                "time_std": entry["time_std"],
+                "repeats": entry["repeats"],
                 "efficiency": efficiency,
-                "wall_time": elapsed_time,
+                "inverse_size": engine["inverse_size"],
+                "inverse_time": engine["inverse_time"],
+                "inverse_efficiency": engine.get("inverse_efficiency", 1.0) * 100,
                 "success": True
             }
-            
-            print(f"   Weak Scaling Efficiency: {efficiency:.2f}%")
-            
-        except subprocess.TimeoutExpired:
-            print(f"   ✗ Timeout after 10 minutes")
-            measurement = {
-                "num_processors": num_procs,
-                "matrix_size": matrix_size,
-                "work_per_processor": (matrix_size**2) / num_procs,
-                "time": None,
-                "efficiency": None,
-                "success": False,
-                "error": "timeout"
-            }
-        except Exception as e:
-            print(f"   ✗ Error: {str(e)}")
+        else:
+            print(f"   ✗ All runs failed (see {orchestrator.sweep_dir})")
             measurement = {
                 "num_processors": num_procs,
-                "matrix_size": matrix_size,
-                "work_per_processor": (matrix_size**2) / num_procs,
                 "time": None,
                 "efficiency": None,
                 "success": False,
-                "error": str(e)
+                "error": "all runs failed"
             }
         
         results["measurements"].append(measurement)
-        time.sleep(2)
     
     # Save results
     timestamp_str = datetime.now().strftime("%Y%m%d_%H%M%S")
@@ -195,45 +164,44 @@ def print_summary(results):
 
 def main():
     if len(sys.argv) < 2:
-        print("Usage: python3 weak_scaling.py <executable>")
+        print("Usage: python3 weak_scaling.py <executable> [--base-size=<n>] "
+              "[--scale=memory|flops] [--resume=<sweep_name>]")
         print("Example: python3 weak_scaling.py ./bin/matrix_operations_mpi")
-        print("Example: python3 weak_scaling.py src/matrix_operations_python.py")
         sys.exit(1)
     
     executable = sys.argv[1]
+    sweep_name = None
+    base_size = 2048
+    scale = "memory"
+    for arg in sys.argv[2:]:
+        if arg.startswith("--resume="):
+            sweep_name = arg[len("--resume="):]
+        elif arg.startswith("--base-size="):
+            base_size = int(arg[len("--base-size="):])
+        elif arg.startswith("--scale="):
+            scale = arg[len("--scale="):]
     
     if not os.path.exists(executable):
         print(f"Error: Executable not found: {executable}")
         sys.exit(1)
     
-    # Weak scaling: increase both processors and problem size proportionally
-    # Keep work per processor approximately constant
-    # Format: (num_processors, matrix_size)
-    scaling_configs = [
-        (1, 2048),   # Base case: 1 proc, 2048x2048
-        (2, 2896),   # 2 procs: 2896x2896 (≈2x work)
-        (4, 4096),   # 4 procs: 4096x4096 (≈4x work)
-        (8, 5792),   # 8 procs: 5792x5792 (≈8x work)
-    ]
-    
-    print("\nNote: This script runs the default 4096x4096 matrix.")
-    print("For true weak scaling, you would need to modify the source code")
-    print("to accept matrix size as a parameter.\n")
-    
-    # For now, test with constant matrix size (this is actually strong scaling)
-    # but we keep the framework for when dynamic sizing is implemented
-    scaling_configs_simplified = [
-        (1, 4096),
-        (2, 4096),
-        (4, 4096),
-        (8, 4096),
-    ]
+    if executable.endswith('.py'):
+        print("Error: weak scaling needs the C++ engine (--weak mode)")
+        sys.exit(1)
+    
+    # Weak scaling: the engine derives the matrix size for each processor
+    # count from the per-processor size (2048 -> 2896, 4096, 5792 when
+    # memory-scaled)
+    num_processors_list = [1, 2, 4, 8]
     
     results = run_weak_scaling_test(
-        executable_template=executable,
-        scaling_configs=scaling_configs_simplified,
+        executable=executable,
+        num_processors_list=num_processors_list,
+        base_size=base_size,
+        scale=scale,
         num_threads=4,
-        test_name="weak_scaling_test"
+        test_name="weak_scaling_test",
+        sweep_name=sweep_name
     )
     
     print_summary(results)
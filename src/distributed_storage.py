@@ -6,41 +6,911 @@ Handles storage, retrieval, and management of large matrices across distributed
 
 import os
 import json
+import shutil
+import sqlite3
+import struct
+import tempfile
+import threading
+from collections.abc import MutableMapping
+from contextlib import contextmanager
 import numpy as np
 import h5py
 from datetime import datetime
 from pathlib import Path
 import hashlib
+import zlib
+import multiprocessing
+from concurrent.futures import ProcessPoolExecutor, ThreadPoolExecutor
+from multiprocessing import shared_memory
+
+try:
+    import hdf5plugin  # Blosc/LZ4 filters
+except ImportError:
+    hdf5plugin = None
+
+try:
+    import xxhash
+except ImportError:
+    xxhash = None
+
+try:
+    import crc32c  # Castagnoli CRC, hardware-accelerated
+except ImportError:
+    crc32c = None
+
+# Tile edge of the C++ engine (ABFT tiles and gather chunks are 64 rows);
+# HDF5 chunks are multiples of it so each rank's hyperslab maps to whole chunks
+ENGINE_TILE = 64
+
+# Upper bound for one HDF5 chunk; larger chunks hurt partial reads
+MAX_CHUNK_BYTES = 4 * 1024 * 1024
+
+# Matrix shared with forked writer processes (copy-on-write, no pickling)
+_PARALLEL_SOURCE = None
+
+
+def row_partition(n_rows, num_parts):
+    """Row ranges per part, same rule as the engine (last part takes the rest)"""
+    rows_per_part = n_rows // num_parts
+    return [(i * rows_per_part, n_rows if i == num_parts - 1 else (i + 1) * rows_per_part)
+            for i in range(num_parts)]
+
+
+# ----- Integrity: per-chunk leaves and a Merkle root -----
+#
+# Every CHECKSUM_ROWS-row slab of a part gets a fast leaf hash: xxh3-64 when
+# xxhash is installed, else CRC32C when the crc32c package is, else zlib's
+# CRC32 (the IEEE polynomial, recorded as "crc32", not CRC32C). All of them
+# hash the array buffer in place and release the GIL, so a thread pool
+# hashes slabs in parallel. Each entry records its algorithm.
+# Leaves never straddle part boundaries. The metadata keeps the leaves and
+# a SHA-256 Merkle root over them, so a read re-hashes only the slabs it
+# touched and checks the stored leaves against the root.
+
+CHECKSUM_ROWS = ENGINE_TILE
+
+_hash_pool = None
+
+
+def checksum_algorithm():
+    if xxhash is not None:
+        return "xxh3_64"
+    return "crc32c" if crc32c is not None else "crc32"
+
+
+def _reset_hash_pool():
+    global _hash_pool
+    _hash_pool = None
+
+
+# The pool's threads do not survive fork; forked workers build their own
+os.register_at_fork(after_in_child=_reset_hash_pool)
+
+
+def _hash_pool_instance():
+    global _hash_pool
+    if _hash_pool is None:
+        _hash_pool = ThreadPoolExecutor(max_workers=os.cpu_count() or 1)
+    return _hash_pool
+
+
+def leaf_hash(block, algorithm):
+    """Hash one slab without copying it (it must be C-contiguous)"""
+    block = np.ascontiguousarray(block)
+    if algorithm == "xxh3_64":
+        return xxhash.xxh3_64_hexdigest(block)
+    if algorithm == "crc32c":
+        if crc32c is None:
+            raise ValueError("Checksum algorithm crc32c needs the crc32c package")
+        return format(crc32c.crc32c(block), '08x')
+    if algorithm == "crc32":
+        return format(zlib.crc32(block), '08x')
+    raise ValueError(f"Unknown checksum algorithm: {algorithm}")
+
+
+def submit_leaf_hashes(block, algorithm, rows=CHECKSUM_ROWS, pool=None):
+    """Start hashing the slabs of a row block; returns futures in order"""
+    pool = pool or _hash_pool_instance()
+    return [pool.submit(leaf_hash, block[r:r + rows], algorithm)
+            for r in range(0, block.shape[0], rows)]
+
+
+def chunk_checksums(block, algorithm, rows=CHECKSUM_ROWS, pool=None):
+    """Leaf hashes of a row block, computed in parallel"""
+    return [f.result() for f in submit_leaf_hashes(block, algorithm, rows, pool)]
+
+
+def merkle_root(leaves):
+    """SHA-256 Merkle root over leaf hashes (odd nodes are promoted)"""
+    level = [hashlib.sha256(leaf.encode()).digest() for leaf in leaves]
+    if not level:
+        return hashlib.sha256(b"").hexdigest()
+    while len(level) > 1:
+        level = [hashlib.sha256(level[i] + level[i + 1]).digest() if i + 1 < len(level)
+                 else level[i] for i in range(0, len(level), 2)]
+    return level[0].hex()
+
+
+def tile_chunk_shape(rows, cols, itemsize, tile=ENGINE_TILE):
+    """Chunk shape aligned to the engine tile and capped at MAX_CHUNK_BYTES"""
+    chunk_rows = max(1, min(rows, tile))
+    chunk_cols = cols
+    while chunk_rows * chunk_cols * itemsize > MAX_CHUNK_BYTES and chunk_cols > tile:
+        chunk_cols = max(tile, (chunk_cols // 2) // tile * tile)
+    return (chunk_rows, chunk_cols)
+
+
+def fast_filter():
+    """Dataset keyword arguments for the fastest available filter"""
+    if hdf5plugin is not None:
+        return dict(hdf5plugin.Blosc(cname='lz4', clevel=5, shuffle=hdf5plugin.Blosc.SHUFFLE)), "blosc-lz4"
+    return {"compression": "lzf", "shuffle": True}, "lzf+shuffle"
+
+
+def _write_part(part_file, block, chunks, compress, algorithm):
+    """Write one row block as its own HDF5 file; returns its leaf hashes"""
+    filter_kwargs = fast_filter()[0] if compress else {}
+    futures = submit_leaf_hashes(block, algorithm)
+    with h5py.File(part_file, 'w') as f:
+        f.create_dataset('matrix', data=block, chunks=chunks, **filter_kwargs)
+    return [fut.result() for fut in futures]
+
+
+# ----- Tiled layout -----
+#
+# "<name>.tiles": a 64-byte header, then tile x tile blocks in tile-major
+# order with zero-padded edge tiles. It is the format of save_matrix_tiled
+# in the C++ engine, so either side reads the other's files.
+
+TILED_MAGIC = b"MTIL"
+TILED_VERSION = 1
+TILED_HEADER = struct.Struct("<4sIQQQ8s24x")
+DEFAULT_STORE_TILE = 256
+
+
+def create_tiles(path, rows, cols, tile, dtype):
+    """Create a zero-filled tiled file; returns its tiles memmap"""
+    dtype = np.dtype(dtype)
+    grid = (-(-rows // tile), -(-cols // tile))
+    with open(path, 'wb') as f:
+        f.write(TILED_HEADER.pack(TILED_MAGIC, TILED_VERSION, rows, cols, tile,
+                                  dtype.str.encode()))
+        f.truncate(TILED_HEADER.size + grid[0] * grid[1] * tile * tile * dtype.itemsize)
+    return open_tiles(path, 'r+')[0]
+
+
+def open_tiles(path, mode='r'):
+    """(tiles memmap of shape (tile_rows, tile_cols, tile, tile), rows, cols, tile)"""
+    with open(path, 'rb') as f:
+        magic, version, rows, cols, tile, dtype = TILED_HEADER.unpack(f.read(TILED_HEADER.size))
+    if magic != TILED_MAGIC or version != TILED_VERSION:
+        raise ValueError(f"{path} is not a tiled matrix file")
+    dtype = np.dtype(dtype.rstrip(b"\0").decode())
+    grid = (-(-rows // tile), -(-cols // tile))
+    tiles = np.memmap(path, dtype=dtype, mode=mode, offset=TILED_HEADER.size,
+                      shape=grid + (tile, tile))
+    return tiles, rows, cols, tile
+
+
+def block_bounds(rows, cols, shape):
+    """(r0, r1, c0, c1) of contiguous row/column slices (None = all)"""
+    r0, r1, r_step = (rows or slice(None)).indices(shape[0])
+    c0, c1, c_step = (cols or slice(None)).indices(shape[1])
+    if r_step != 1 or c_step != 1:
+        raise ValueError("Tiled loads take contiguous row and column ranges")
+    return r0, max(r0, r1), c0, max(c0, c1)
+
+
+def assemble_block(bounds, tile, dtype, fetch_tile, pool=None):
+    """
+    Build a block from the tiles it overlaps; fetch_tile(ti, tj) returns a
+    full tile x tile array. Tiles are fetched concurrently when a pool is given.
+    """
+    r0, r1, c0, c1 = bounds
+    out = np.empty((r1 - r0, c1 - c0), dtype=dtype)
+    
+    def place(ti_tj):
+        ti, tj = ti_tj
+        block = fetch_tile(ti, tj)
+        br0, br1 = max(r0, ti * tile), min(r1, (ti + 1) * tile)
+        bc0, bc1 = max(c0, tj * tile), min(c1, (tj + 1) * tile)
+        out[br0 - r0:br1 - r0, bc0 - c0:bc1 - c0] = \
+            block[br0 - ti * tile:br1 - ti * tile, bc0 - tj * tile:bc1 - tj * tile]
+    
+    touched = [(ti, tj) for ti in range(r0 // tile, -(-r1 // tile))
+               for tj in range(c0 // tile, -(-c1 // tile))]
+    list(pool.map(place, touched) if pool is not None else map(place, touched))
+    return out
+
+
+def tile_digest(block):
+    """Content address of a tile (BLAKE2b-160; releases the GIL while hashing)"""
+    return hashlib.blake2b(np.ascontiguousarray(block), digest_size=20).hexdigest()
+
+
+def _fsync_dir(path):
+    """Make renames inside a directory durable"""
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        os.fsync(fd)
+    finally:
+        os.close(fd)
+
+
+def _save_npy_atomic(part_file, block, algorithm):
+    """
+    Write one .npy part under a temporary name, fsync it and rename it into
+    place, so the part path only ever holds a complete file. Returns the
+    part's leaf hashes (computed while the write is in flight).
+    """
+    part_file = Path(part_file)
+    tmp_file = part_file.with_name(part_file.name + ".tmp")
+    futures = submit_leaf_hashes(block, algorithm)
+    try:
+        with open(tmp_file, 'wb') as f:
+            np.save(f, block)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_file, part_file)
+    except BaseException:
+        if tmp_file.exists():
+            tmp_file.unlink()
+        raise
+    return [fut.result() for fut in futures]
+
+
+def _write_part_worker(part_file, start_row, end_row, chunks, compress, algorithm):
+    return _write_part(part_file, _PARALLEL_SOURCE[start_row:end_row], chunks, compress,
+                       algorithm)
+
+
+def _read_part_worker(part_file, start_row, end_row, shm_name, shape, dtype, algorithm):
+    """Decompress one part straight into the shared output buffer"""
+    shm = shared_memory.SharedMemory(name=shm_name)
+    try:
+        out = np.ndarray(shape, dtype=dtype, buffer=shm.buf)
+        with h5py.File(part_file, 'r') as f:
+            f['matrix'].read_direct(out, dest_sel=np.s_[start_row:end_row])
+        leaves = chunk_checksums(out[start_row:end_row], algorithm) if algorithm else None
+        del out
+        return leaves
+    finally:
+        shm.close()
+
+
+def shared_source(path):
+    """Read straight from shared storage"""
+    path = Path(path)
+    if not path.exists():
+        raise FileNotFoundError(f"Storage file not found: {path}")
+    return path
+
+
+class DistributedMatrixView:
+    """
+    Lazy view of a matrix stored as row-partitioned .npy parts
+    
+    Parts are memory-mapped on first use, so indexing copies only the
+    selected rows and columns out of the parts that hold them. Rows and
+    columns take integers or slices; read() materializes the whole matrix
+    into one (optionally preallocated) buffer with parallel part copies.
+    """
+    
+    def __init__(self, name, info, verify=None, source=None):
+        self.name = name
+        self.shape = tuple(info["shape"])
+        self.dtype = np.dtype(info["dtype"])
+        self.ndim = 2
+        self._parts = [(p["rows"][0], p["rows"][1], Path(p["path"])) for p in info["parts"]]
+        self._maps = [None] * len(self._parts)
+        self._verify = verify  # callable(block, start_row) for full-width rows
+        self._source = source or shared_source  # Maps a part path to the file to open
+    
+    def __len__(self):
+        return self.shape[0]
+    
+    def __repr__(self):
+        return f"DistributedMatrixView('{self.name}', shape={self.shape}, dtype={self.dtype})"
+    
+    def __array__(self, dtype=None, copy=None):
+        matrix = self.read()
+        return matrix if dtype is None else matrix.astype(dtype, copy=False)
+    
+    def _part(self, i):
+        if self._maps[i] is None:
+            self._maps[i] = np.load(self._source(self._parts[i][2]), mmap_mode='r')
+        return self._maps[i]
+    
+    def __getitem__(self, key):
+        row_key, col_key = key if isinstance(key, tuple) else (key, slice(None))
+        for k in (row_key, col_key):
+            if not isinstance(k, (int, np.integer, slice)):
+                raise TypeError("DistributedMatrixView supports integer and slice indexing")
+        
+        if not isinstance(row_key, slice):
+            row = int(row_key) + (self.shape[0] if row_key < 0 else 0)
+            if not 0 <= row < self.shape[0]:
+                raise IndexError(f"Row {row_key} out of range for {self.shape[0]} rows")
+            return self[row:row + 1, col_key][0]
+        
+        rows = range(*row_key.indices(self.shape[0]))
+        col_shape = () if not isinstance(col_key, slice) else \
+            (len(range(*col_key.indices(self.shape[1]))),)
+        out = np.empty((len(rows),) + col_shape, dtype=self.dtype)
+        
+        for i, (p_start, p_end, _) in enumerate(self._parts):
+            # Positions in the selection whose row falls inside this part
+            if rows.step > 0:
+                k0 = len(range(rows.start, min(p_start, rows.stop), rows.step))
+                k1 = len(range(rows.start, min(p_end, rows.stop), rows.step))
+            else:
+                k0 = len(range(rows.start, max(p_end - 1, rows.stop), rows.step))
+                k1 = len(range(rows.start, max(p_start - 1, rows.stop), rows.step))
+            if k1 <= k0:
+                continue
+            first = rows[k0] - p_start
+            end = first + (k1 - k0) * rows.step
+            local = slice(first, end if end >= 0 else None, rows.step)
+            out[k0:k1] = self._part(i)[local, col_key]
+        
+        full_width = isinstance(col_key, slice) and \
+            col_key.indices(self.shape[1]) == (0, self.shape[1], 1)
+        if self._verify is not None and rows.step == 1 and full_width and len(rows):
+            self._verify(out, rows.start)
+        return out
+    
+    def read(self, out=None, num_workers=None):
+        """
+        Materialize the matrix, copying parts concurrently
+        
+        Args:
+            out: optional preallocated C-contiguous array of the full shape
+            num_workers: copy threads (default: one per part, up to the cores)
+        """
+        if out is None:
+            out = np.empty(self.shape, dtype=self.dtype)
+        elif out.shape != self.shape or out.dtype != self.dtype:
+            raise ValueError(f"Output buffer must be {self.shape} {self.dtype}, "
+                             f"got {out.shape} {out.dtype}")
+        
+        def copy_part(i):
+            p_start, p_end, _ = self._parts[i]
+            out[p_start:p_end] = self._part(i)
+        
+        num_workers = num_workers or min(len(self._parts), os.cpu_count() or 1)
+        with ThreadPoolExecutor(max_workers=max(1, num_workers)) as pool:
+            list(pool.map(copy_part, range(len(self._parts))))
+        
+        if self._verify is not None:
+            self._verify(out, 0)
+        return out
+
+
+class LocalCacheTier:
+    """
+    Node-local mirror of shared-storage files (e.g. a scratch SSD)
+    
+    Files are keyed by their shared path and mirrored under cache_dir with
+    the same layout. Reads use the local copy when there is one; callers
+    validate it against the stored checksums and invalidate() it on a
+    mismatch. Size is bounded by capacity_mb with least-recently-used
+    eviction (recency is the file mtime, so noatime mounts work too).
+    In write-back mode saves land here first and a background thread copies
+    them to shared storage; drain() waits for the copies. A written-back
+    file stays pinned (never evicted) until its copy succeeds; a failed copy
+    keeps it pinned and is retried, then raised, by drain().
+    """
+    
+    def __init__(self, cache_dir, capacity_mb=4096, write_back=False):
+        self.cache_dir = Path(cache_dir)
+        self.cache_dir.mkdir(parents=True, exist_ok=True)
+        self.capacity_bytes = int(capacity_mb * 1024**2)
+        self.write_back = write_back
+        self.hits = 0
+        self.misses = 0
+        self._lock = threading.Lock()
+        self._pending = {}  # shared path -> drain future
+        self._failed = {}   # paths of a failed drain -> (shared_paths, on_done)
+        self._drain_pool = ThreadPoolExecutor(max_workers=1) if write_back else None
+    
+    def local_path(self, shared_path):
+        shared_path = Path(shared_path).resolve()
+        return self.cache_dir / shared_path.relative_to(shared_path.anchor)
+    
+    def write_path(self, shared_path):
+        """Where a save should write: the cache in write-back mode"""
+        if not self.write_back:
+            return Path(shared_path)
+        local = self.local_path(shared_path)
+        local.parent.mkdir(parents=True, exist_ok=True)
+        return local
+    
+    def resolve(self, shared_path):
+        """Path to read from, mirroring the shared file on a miss"""
+        local = self.local_path(shared_path)
+        if local.exists():
+            os.utime(local)  # LRU touch
+            self.hits += 1
+            return local
+        self.misses += 1
+        if not Path(shared_path).exists():
+            raise FileNotFoundError(f"Storage file not found: {shared_path}")
+        size = os.path.getsize(shared_path)
+        if size > self.capacity_bytes:
+            return Path(shared_path)
+        self._evict(size)
+        local.parent.mkdir(parents=True, exist_ok=True)
+        # Unique temp name: ranks on this node may mirror the same file
+        fd, tmp_file = tempfile.mkstemp(dir=local.parent, prefix=local.name + ".",
+                                        suffix=".tmp")
+        try:
+            with os.fdopen(fd, 'wb') as dst, open(shared_path, 'rb') as src:
+                shutil.copyfileobj(src, dst, 16 * 1024**2)
+            os.replace(tmp_file, local)
+        except BaseException:
+            Path(tmp_file).unlink(missing_ok=True)
+            raise
+        return local
+    
+    def invalidate(self, shared_path):
+        local = self.local_path(shared_path)
+        with self._lock:
+            if str(shared_path) in self._pending:
+                return  # The cached copy is the only one until it drains
+        if local.exists():
+            local.unlink()
+    
+    def discard(self, shared_paths):
+        """Drop the cached copies of deleted files, with any failed drain of them"""
+        keys = {str(p) for p in shared_paths}
+        with self._lock:
+            for key in [k for k in self._failed if keys.intersection(k)]:
+                del self._failed[key]
+            for key in keys:
+                self._pending.pop(key, None)
+        for shared_path in shared_paths:
+            self.local_path(shared_path).unlink(missing_ok=True)
+            Path(str(shared_path) + ".tmp").unlink(missing_ok=True)
+    
+    def _evict(self, incoming):
+        with self._lock:
+            pinned = {self.local_path(p) for p in self._pending}
+        files = []
+        for f in self.cache_dir.rglob('*'):
+            if f.is_file() and not f.name.endswith('.tmp'):
+                st = f.stat()
+                files.append((st.st_mtime, st.st_size, f))
+        used = sum(size for _, size, _ in files)
+        for _, size, f in sorted(files):
+            if used + incoming <= self.capacity_bytes:
+                break
+            if f in pinned:
+                continue
+            f.unlink(missing_ok=True)
+            used -= size
+    
+    def drain_async(self, shared_paths, on_done=None):
+        """Copy written-back files to shared storage in the background"""
+        def drain():
+            for shared_path in shared_paths:
+                tmp_file = Path(str(shared_path) + ".tmp")
+                with open(self.local_path(shared_path), 'rb') as src, open(tmp_file, 'wb') as dst:
+                    shutil.copyfileobj(src, dst, 16 * 1024**2)
+                    dst.flush()
+                    os.fsync(dst.fileno())
+                os.replace(tmp_file, shared_path)
+            _fsync_dir(Path(shared_paths[0]).parent)
+            if on_done is not None:
+                on_done()
+        
+        def finished(future):
+            key = tuple(str(p) for p in shared_paths)
+            with self._lock:
+                if future.exception() is not None:
+                    self._failed[key] = (shared_paths, on_done)  # Stays pinned
+                    return
+                self._failed.pop(key, None)
+                for shared_path in key:
+                    if self._pending.get(shared_path) is future:
+                        del self._pending[shared_path]
+        
+        with self._lock:
+            future = self._drain_pool.submit(drain)
+            for shared_path in shared_paths:
+                self._pending[str(shared_path)] = future
+        future.add_done_callback(finished)
+        return future
+    
+    def drain(self):
+        """
+        Wait until every written-back file is on shared storage
+        
+        Drains that failed earlier are retried first. Raises OSError if any
+        copy still fails; those files stay pinned in the cache.
+        """
+        with self._lock:
+            retry = list(self._failed.values())
+            self._failed.clear()
+        for shared_paths, on_done in retry:
+            self.drain_async(shared_paths, on_done)
+        
+        with self._lock:
+            futures = set(self._pending.values())
+        errors = []
+        for future in futures:
+            try:
+                future.result()
+            except Exception as e:
+                errors.append(e)
+        if errors:
+            raise OSError(f"{len(errors)} write-back drain(s) failed, cached copies kept "
+                          f"in {self.cache_dir}: {errors[0]}")
+    
+    def stats(self):
+        used = sum(f.stat().st_size for f in self.cache_dir.rglob('*') if f.is_file())
+        return {"cache_dir": str(self.cache_dir), "cache_used_mb": used / (1024**2),
+                "cache_capacity_mb": self.capacity_bytes / (1024**2),
+                "cache_hits": self.hits, "cache_misses": self.misses,
+                "cache_pending_drains": len(self._pending),
+                "cache_failed_drains": len(self._failed)}
+
+
+class MetadataStore(MutableMapping):
+    """
+    Matrix metadata in SQLite (storage_metadata.db), as a name -> info mapping
+    
+    One row per matrix keyed by name, so lookups and updates go through the
+    primary-key B-tree in O(log N) instead of rewriting one JSON file. Every
+    write is its own transaction under the database lock; writers from
+    concurrent jobs wait (up to `timeout`) rather than clobber each other.
+    The default rollback journal is kept because WAL needs shared memory and
+    does not work on network filesystems. Entries of a legacy
+    storage_metadata.json are imported once, on first open.
+    
+    The same database holds the snapshot version chains and the reference
+    counts of the content-addressed tiles they share.
+    """
+    
+    SCHEMA = ["""CREATE TABLE IF NOT EXISTS matrices (
+                     name TEXT PRIMARY KEY,
+                     type TEXT NOT NULL,
+                     size_mb REAL NOT NULL,
+                     info TEXT NOT NULL,
+                     updated TEXT NOT NULL
+                 ) WITHOUT ROWID""",
+              """CREATE TABLE IF NOT EXISTS snapshots (
+                     name TEXT NOT NULL,
+                     version INTEGER NOT NULL,
+                     parent INTEGER,
+                     info TEXT NOT NULL,
+                     tiles TEXT NOT NULL,
+                     new_tiles INTEGER NOT NULL,
+                     created TEXT NOT NULL,
+                     PRIMARY KEY (name, version)
+                 ) WITHOUT ROWID""",
+              """CREATE TABLE IF NOT EXISTS tile_refs (
+                     hash TEXT PRIMARY KEY,
+                     refs INTEGER NOT NULL,
+                     bytes INTEGER NOT NULL
+                 ) WITHOUT ROWID"""]
+    
+    def __init__(self, db_file, legacy_json=None, timeout=60.0):
+        self.db_file = str(db_file)
+        self.timeout = timeout
+        self._local = threading.local()  # One connection per thread
+        imported = False
+        with self._transaction() as db:
+            for statement in self.SCHEMA:
+                db.execute(statement)
+            if legacy_json is not None and Path(legacy_json).exists():
+                self._import_json(db, Path(legacy_json))
+                imported = True
+        if imported:
+            # Only once the import has committed: a failed import keeps the JSON
+            legacy_json = Path(legacy_json)
+            try:
+                os.replace(legacy_json, legacy_json.with_name(legacy_json.name + ".imported"))
+            except FileNotFoundError:
+                pass  # Another process importing concurrently renamed it first
+    
+    def _connection(self):
+        db = getattr(self._local, "db", None)
+        if db is None:
+            db = sqlite3.connect(self.db_file, timeout=self.timeout, isolation_level=None)
+            self._local.db = db
+        return db
+    
+    @contextmanager
+    def _transaction(self):
+        db = self._connection()
+        db.execute("BEGIN IMMEDIATE")
+        try:
+            yield db
+        except BaseException:
+            db.execute("ROLLBACK")
+            raise
+        db.execute("COMMIT")
+    
+    def _import_json(self, db, legacy_json):
+        with open(legacy_json, 'r') as f:
+            matrices = json.load(f).get("matrices", {})
+        db.executemany("INSERT OR IGNORE INTO matrices VALUES (?, ?, ?, ?, ?)",
+                       [self._row(name, info) for name, info in matrices.items()])
+    
+    @staticmethod
+    def _row(name, info):
+        return (name, info.get("type", "single"), info.get("size_mb", 0.0),
+                json.dumps(info), datetime.now().isoformat())
+    
+    def __getitem__(self, name):
+        row = self._connection().execute(
+            "SELECT info FROM matrices WHERE name = ?", (name,)).fetchone()
+        if row is None:
+            raise KeyError(name)
+        return json.loads(row[0])
+    
+    def __setitem__(self, name, info):
+        with self._transaction() as db:
+            db.execute("INSERT OR REPLACE INTO matrices VALUES (?, ?, ?, ?, ?)",
+                       self._row(name, info))
+    
+    def __delitem__(self, name):
+        with self._transaction() as db:
+            if db.execute("DELETE FROM matrices WHERE name = ?", (name,)).rowcount == 0:
+                raise KeyError(name)
+    
+    def __contains__(self, name):
+        return self._connection().execute(
+            "SELECT 1 FROM matrices WHERE name = ?", (name,)).fetchone() is not None
+    
+    def __iter__(self):
+        rows = self._connection().execute("SELECT name FROM matrices ORDER BY name").fetchall()
+        return iter([row[0] for row in rows])
+    
+    def __len__(self):
+        return self._connection().execute("SELECT COUNT(*) FROM matrices").fetchone()[0]
+    
+    def items(self):
+        rows = self._connection().execute(
+            "SELECT name, info FROM matrices ORDER BY name").fetchall()
+        return [(name, json.loads(info)) for name, info in rows]
+    
+    def total_size_mb(self):
+        return self._connection().execute(
+            "SELECT COALESCE(SUM(size_mb), 0) FROM matrices").fetchone()[0]
+    
+    # ----- Snapshots -----
+    
+    def has_tile(self, digest):
+        return self._connection().execute(
+            "SELECT 1 FROM tile_refs WHERE hash = ?", (digest,)).fetchone() is not None
+    
+    def add_snapshot(self, name, info, tiles, tile_bytes, ensure_tile):
+        """
+        Append a version to name's chain and take a reference on each tile.
+        ensure_tile(index) runs under the database lock for tiles nothing
+        references yet, so a concurrent delete cannot have removed an object
+        this version relies on. Returns (version, number of new tiles).
+        """
+        with self._transaction() as db:
+            parent = db.execute("SELECT MAX(version) FROM snapshots WHERE name = ?",
+                                (name,)).fetchone()[0]
+            version = (parent or 0) + 1
+            new_tiles = 0
+            for index, digest in enumerate(tiles):
+                if db.execute("UPDATE tile_refs SET refs = refs + 1 WHERE hash = ?",
+                              (digest,)).rowcount == 0:
+                    ensure_tile(index)
+                    db.execute("INSERT INTO tile_refs VALUES (?, 1, ?)", (digest, tile_bytes))
+                    new_tiles += 1
+            db.execute("INSERT INTO snapshots VALUES (?, ?, ?, ?, ?, ?, ?)",
+                       (name, version, parent, json.dumps(info), json.dumps(tiles),
+                        new_tiles, datetime.now().isoformat()))
+        return version, new_tiles
+    
+    def get_snapshot(self, name, version=None):
+        """(version, info, tiles) of a version (default: the latest)"""
+        db = self._connection()
+        if version is None:
+            row = db.execute("SELECT version, info, tiles FROM snapshots WHERE name = ? "
+                             "ORDER BY version DESC LIMIT 1", (name,)).fetchone()
+        else:
+            row = db.execute("SELECT version, info, tiles FROM snapshots "
+                             "WHERE name = ? AND version = ?", (name, version)).fetchone()
+        if row is None:
+            raise KeyError((name, version))
+        return row[0], json.loads(row[1]), json.loads(row[2])
+    
+    def list_snapshots(self, name):
+        rows = self._connection().execute(
+            "SELECT version, parent, info, new_tiles, created FROM snapshots "
+            "WHERE name = ? ORDER BY version", (name,)).fetchall()
+        return [dict(json.loads(info), version=version, parent=parent, new_tiles=new_tiles,
+                     created=created) for version, parent, info, new_tiles, created in rows]
+    
+    def drop_snapshot(self, name, version, remove_tile):
+        """Delete a version; remove_tile(hash) runs for tiles nothing references"""
+        with self._transaction() as db:
+            row = db.execute("SELECT tiles FROM snapshots WHERE name = ? AND version = ?",
+                             (name, version)).fetchone()
+            if row is None:
+                raise KeyError((name, version))
+            db.execute("DELETE FROM snapshots WHERE name = ? AND version = ?", (name, version))
+            for digest in json.loads(row[0]):
+                db.execute("UPDATE tile_refs SET refs = refs - 1 WHERE hash = ?", (digest,))
+            for (digest,) in db.execute("SELECT hash FROM tile_refs WHERE refs <= 0").fetchall():
+                remove_tile(digest)
+                db.execute("DELETE FROM tile_refs WHERE hash = ?", (digest,))
+    
+    def snapshot_usage(self):
+        """(versions, logical bytes, stored bytes) over all snapshot chains"""
+        db = self._connection()
+        versions, logical = 0, 0
+        for info, tiles in db.execute("SELECT info, tiles FROM snapshots").fetchall():
+            versions += 1
+            logical += json.loads(info)["tile_bytes"] * len(json.loads(tiles))
+        stored = db.execute("SELECT COALESCE(SUM(bytes), 0) FROM tile_refs").fetchone()[0]
+        return versions, logical, stored
+
 
 class DistributedStorageManager:
     """
     Manages distributed storage for large matrices
     Supports chunked storage, compression, and metadata tracking
+    
+    With cache_dir set, reads of save_matrix/save_matrix_distributed files go
+    through a LocalCacheTier (validated by checksum, falling back to shared
+    storage); with write_back=True saves also land in the cache and drain to
+    shared storage in the background. A written-back matrix is registered in
+    the metadata store only once it has fully drained.
     """
     
-    def __init__(self, storage_dir="data/distributed", compression="gzip"):
+    def __init__(self, storage_dir="data/distributed", compression="gzip",
+                 cache_dir=None, cache_size_mb=4096, write_back=False):
         self.storage_dir = Path(storage_dir)
         self.storage_dir.mkdir(parents=True, exist_ok=True)
         self.compression = compression
-        self.metadata_file = self.storage_dir / "storage_metadata.json"
-        self.metadata = self._load_metadata()
+        self.metadata_file = self.storage_dir / "storage_metadata.db"
+        self.matrices = MetadataStore(self.metadata_file,
+                                      legacy_json=self.storage_dir / "storage_metadata.json")
+        self.cache = LocalCacheTier(cache_dir, cache_size_mb, write_back) if cache_dir else None
+        self._draining_lock = threading.Lock()
+        self._draining = {}  # Written-back entries not yet in the store
         
-    def _load_metadata(self):
-        """Load metadata from disk"""
-        if self.metadata_file.exists():
-            with open(self.metadata_file, 'r') as f:
-                return json.load(f)
-        return {"matrices": {}}
+    def _info(self, name):
+        """Metadata of a stored matrix (including ones still draining)"""
+        with self._draining_lock:
+            if name in self._draining:
+                return self._draining[name]
+        try:
+            return self.matrices[name]
+        except KeyError:
+            raise ValueError(f"Matrix '{name}' not found in storage") from None
     
-    def _save_metadata(self):
-        """Save metadata to disk"""
-        with open(self.metadata_file, 'w') as f:
-            json.dump(self.metadata, f, indent=2)
+    def _write_path(self, shared_path):
+        return self.cache.write_path(shared_path) if self.cache else Path(shared_path)
+    
+    def _entry_files(self, info):
+        """Shared-storage files of a metadata entry"""
+        if info is None:
+            return []
+        paths = [p["path"] for p in info.get("parts", [])] + [info.get("path")]
+        return [p for p in paths if p]
+    
+    def _register(self, name, entry, shared_paths, superseded=None):
+        """
+        Record a saved matrix once its files are on shared storage, then
+        delete the files of the entry it replaced (`superseded`)
+        """
+        def retire():
+            keep = {str(p) for p in shared_paths}
+            for path in self._entry_files(superseded):
+                if str(path) in keep:
+                    continue
+                Path(path).unlink(missing_ok=True)
+                if self.cache is not None:
+                    self.cache.invalidate(path)
+                try:
+                    Path(path).parent.rmdir()  # Its version directory, once empty
+                except OSError:
+                    pass
+        
+        if self.cache is not None and self.cache.write_back:
+            def drained():
+                self.matrices[name] = entry
+                with self._draining_lock:
+                    self._draining.pop(name, None)
+                retire()
+            with self._draining_lock:
+                self._draining[name] = entry
+            self.cache.drain_async(shared_paths, on_done=drained)
+            return
+        if self.cache is not None:
+            for path in shared_paths:
+                self.cache.invalidate(path)
+        self.matrices[name] = entry
+        retire()
+    
+    def _read_validated(self, name, shared_paths, read, verify):
+        """
+        read(source) loads a matrix, opening source(path) for each stored
+        file; read or verify(matrix) raise ValueError on a checksum
+        mismatch. A cached copy that fails validation is dropped and shared
+        storage is read instead.
+        """
+        if self.cache is not None:
+            try:
+                matrix = read(self.cache.resolve)
+                verify(matrix)
+                return matrix
+            except ValueError:
+                for path in shared_paths:
+                    self.cache.invalidate(path)
+                print(f"[Storage] Cached copy of '{name}' failed validation; "
+                      f"reading shared storage")
+        matrix = read(shared_source)
+        verify(matrix)
+        return matrix
+    
+    def drain(self):
+        """Wait for written-back matrices to reach shared storage"""
+        if self.cache is not None:
+            self.cache.drain()
     
     def _compute_checksum(self, data):
-        """Compute checksum for data integrity"""
+        """Whole-matrix SHA-256 (entries saved before per-chunk checksums)"""
         return hashlib.sha256(data.tobytes()).hexdigest()
     
+    def _integrity_segments(self, info):
+        """(start_row, end_row, leaves) per part of a stored matrix"""
+        if "parts" in info:
+            return [(p["rows"][0], p["rows"][1], p["leaves"]) for p in info["parts"]]
+        return [(0, info["shape"][0], info["leaves"])]
+    
+    def _verify_rows(self, name, info, block, start_row=0):
+        """
+        Verify full-width rows [start_row, start_row + len(block)) against the
+        stored leaves; slabs only partly covered by the block are skipped
+        """
+        if "merkle_root" not in info:
+            # Legacy entry: whole-matrix SHA-256
+            if start_row == 0 and block.shape[0] == info["shape"][0]:
+                if self._compute_checksum(block) != info["checksum"]:
+                    raise ValueError(f"Checksum mismatch for matrix '{name}'")
+            return
+        
+        segments = self._integrity_segments(info)
+        all_leaves = [leaf for _, _, leaves in segments for leaf in leaves]
+        if merkle_root(all_leaves) != info["merkle_root"]:
+            raise ValueError(f"Checksum tree of matrix '{name}' does not match its root")
+        
+        algorithm = info["checksum_algorithm"]
+        rows = info["checksum_rows"]
+        end_row = start_row + block.shape[0]
+        checks = []
+        for seg_start, seg_end, leaves in segments:
+            for i, leaf in enumerate(leaves):
+                r0 = seg_start + i * rows
+                r1 = min(r0 + rows, seg_end)
+                if r0 >= start_row and r1 <= end_row:
+                    checks.append((r0, leaf, _hash_pool_instance().submit(
+                        leaf_hash, block[r0 - start_row:r1 - start_row], algorithm)))
+        for r0, leaf, future in checks:
+            if future.result() != leaf:
+                raise ValueError(f"Checksum mismatch for matrix '{name}' at rows {r0}+")
+    
+    def _record_integrity(self, entry, part_leaves):
+        """Add algorithm, leaves and Merkle root to a metadata entry"""
+        entry["checksum_algorithm"] = checksum_algorithm()
+        entry["checksum_rows"] = CHECKSUM_ROWS
+        if "parts" in entry:
+            for part, leaves in zip(entry["parts"], part_leaves):
+                part["leaves"] = leaves
+        else:
+            entry["leaves"] = part_leaves[0]
+        entry["merkle_root"] = merkle_root([leaf for leaves in part_leaves for leaf in leaves])
+        return entry
+    
     def save_matrix(self, matrix, name, chunk_size=1024, compress=True):
         """
         Save matrix to distributed storage with chunking
@@ -57,18 +927,27 @@ class DistributedStorageManager:
         # Save using HDF5 for efficient storage
         h5_file = matrix_dir / f"{name}.h5"
         
-        with h5py.File(h5_file, 'w') as f:
+        # Leaves are hashed by the pool while the slabs stream to disk
+        leaf_futures = submit_leaf_hashes(matrix, checksum_algorithm())
+        
+        with h5py.File(self._write_path(h5_file), 'w') as f:
             if compress:
                 dset = f.create_dataset(
                     'matrix', 
-                    data=matrix,
+                    shape=matrix.shape,
+                    dtype=matrix.dtype,
                     compression=self.compression,
                     compression_opts=4,
                     chunks=(min(chunk_size, matrix.shape[0]), 
                            min(chunk_size, matrix.shape[1]))
                 )
+                slab_rows = dset.chunks[0]
             else:
-                dset = f.create_dataset('matrix', data=matrix)
+                dset = f.create_dataset('matrix', shape=matrix.shape, dtype=matrix.dtype)
+                slab_rows = chunk_size
+            
+            for r in range(0, matrix.shape[0], slab_rows):
+                dset[r:r + slab_rows] = matrix[r:r + slab_rows]
             
             # Add attributes
             dset.attrs['shape'] = matrix.shape
@@ -76,16 +955,16 @@ class DistributedStorageManager:
             dset.attrs['timestamp'] = datetime.now().isoformat()
         
         # Update metadata
-        self.metadata["matrices"][name] = {
+        entry = {
             "path": str(h5_file),
             "shape": matrix.shape,
             "dtype": str(matrix.dtype),
             "size_mb": matrix.nbytes / (1024**2),
             "compressed": compress,
-            "checksum": self._compute_checksum(matrix),
             "timestamp": datetime.now().isoformat()
         }
-        self._save_metadata()
+        self._register(name, self._record_integrity(
+            entry, [[fut.result() for fut in leaf_futures]]), [h5_file])
         
         print(f"[Storage] Saved matrix '{name}' ({matrix.shape}) to {h5_file}")
         return str(h5_file)
@@ -98,160 +977,633 @@ class DistributedStorageManager:
             name: identifier of the matrix
             verify_checksum: whether to verify data integrity
         """
-        if name not in self.metadata["matrices"]:
-            raise ValueError(f"Matrix '{name}' not found in storage")
-        
-        info = self.metadata["matrices"][name]
+        info = self._info(name)
         h5_file = Path(info["path"])
         
-        if not h5_file.exists():
-            raise FileNotFoundError(f"Storage file not found: {h5_file}")
+        def read(source):
+            with h5py.File(source(h5_file), 'r') as f:
+                return f['matrix'][:]
         
-        with h5py.File(h5_file, 'r') as f:
-            matrix = f['matrix'][:]
+        def verify(matrix):
+            if verify_checksum:
+                self._verify_rows(name, info, matrix)
         
-        # Verify checksum
-        if verify_checksum:
-            checksum = self._compute_checksum(matrix)
-            if checksum != info["checksum"]:
-                raise ValueError(f"Checksum mismatch for matrix '{name}'")
+        matrix = self._read_validated(name, [h5_file], read, verify)
         
         print(f"[Storage] Loaded matrix '{name}' ({matrix.shape}) from {h5_file}")
         return matrix
     
-    def save_matrix_distributed(self, matrix, name, num_parts=4):
+    def save_matrix_parallel(self, matrix, name, comm=None, num_parts=None,
+                             tile=ENGINE_TILE, compress=True):
+        """
+        Save matrix as tile-chunked HDF5 written concurrently per row block
+        
+        With an mpi4py communicator, `matrix` is this rank's row block (the
+        engine's row partition) and every rank writes its own hyperslab: into
+        one shared file through MPI-IO when h5py is built with parallel HDF5,
+        otherwise into a per-rank file stitched together by a virtual dataset.
+        Without a communicator the full matrix is split into num_parts row
+        blocks written by a process pool.
+        
+        Args:
+            matrix: full matrix, or the local row block when comm is given
+            name: unique identifier for the matrix
+            comm: optional mpi4py communicator
+            num_parts: writer processes without comm (default: CPU count)
+            tile: chunk edge, aligned to the engine's tile
+            compress: use the fast filter (Blosc-LZ4 or LZF, with shuffle)
+        """
+        matrix_dir = self.storage_dir / name
+        matrix_dir.mkdir(exist_ok=True)
+        h5_file = matrix_dir / f"{name}.h5"
+        filter_kwargs, filter_name = fast_filter() if compress else ({}, "none")
+        
+        if comm is not None:
+            rank, size = comm.Get_rank(), comm.Get_size()
+            local_rows = matrix.shape[0]
+            counts = comm.allgather(local_rows)
+            n_rows, n_cols = sum(counts), matrix.shape[1]
+            ranges = row_partition(n_rows, size)
+            if [e - s for s, e in ranges] != counts:
+                raise ValueError("Row blocks do not follow the engine's row partition")
+            chunks = tile_chunk_shape(n_rows // size, n_cols, matrix.dtype.itemsize, tile)
+            start_row, end_row = ranges[rank]
+            algorithm = checksum_algorithm()
+            
+            if h5py.get_config().mpi:
+                layout = "mpio"
+                leaf_futures = submit_leaf_hashes(matrix, algorithm)
+                with h5py.File(h5_file, 'w', driver='mpio', comm=comm) as f:
+                    dset = f.create_dataset('matrix', shape=(n_rows, n_cols), dtype=matrix.dtype,
+                                            chunks=chunks, **filter_kwargs)
+                    with dset.collective:
+                        dset[start_row:end_row, :] = matrix
+                leaves = [fut.result() for fut in leaf_futures]
+                part_files = [str(h5_file)] * size
+            else:
+                layout = "vds"
+                part_file = matrix_dir / f"{name}_part{rank}.h5"
+                leaves = _write_part(part_file, matrix, chunks, compress, algorithm)
+                part_files = [str(matrix_dir / f"{name}_part{i}.h5") for i in range(size)]
+            
+            part_leaves = comm.gather(leaves, root=0)
+            if rank == 0:
+                if layout == "vds":
+                    self._write_virtual_dataset(h5_file, part_files, ranges, n_cols, matrix.dtype)
+                self._record_parallel(name, h5_file, layout, part_files, ranges, (n_rows, n_cols),
+                                      matrix.dtype, chunks, filter_name, part_leaves)
+            comm.Barrier()
+            if rank == 0:
+                print(f"[Storage] Saved matrix '{name}' ({n_rows}, {n_cols}) from {size} ranks "
+                      f"({layout}, {filter_name})")
+            return str(h5_file)
+        
+        # Single process: fork writers that share the matrix copy-on-write
+        global _PARALLEL_SOURCE
+        num_parts = num_parts or os.cpu_count() or 1
+        n_rows, n_cols = matrix.shape
+        num_parts = max(1, min(num_parts, n_rows))
+        ranges = row_partition(n_rows, num_parts)
+        chunks = tile_chunk_shape(n_rows // num_parts, n_cols, matrix.dtype.itemsize, tile)
+        part_files = [str(matrix_dir / f"{name}_part{i}.h5") for i in range(num_parts)]
+        
+        _PARALLEL_SOURCE = matrix
+        try:
+            with ProcessPoolExecutor(max_workers=num_parts,
+                                     mp_context=multiprocessing.get_context("fork")) as pool:
+                futures = [pool.submit(_write_part_worker, part_files[i], s, e, chunks, compress,
+                                       checksum_algorithm())
+                           for i, (s, e) in enumerate(ranges)]
+                part_leaves = [f.result() for f in futures]
+        finally:
+            _PARALLEL_SOURCE = None
+        
+        self._write_virtual_dataset(h5_file, part_files, ranges, n_cols, matrix.dtype)
+        self._record_parallel(name, h5_file, "vds", part_files, ranges, matrix.shape,
+                              matrix.dtype, chunks, filter_name, part_leaves)
+        print(f"[Storage] Saved matrix '{name}' ({matrix.shape}) in {num_parts} parallel parts "
+              f"({filter_name})")
+        return str(h5_file)
+    
+    def _write_virtual_dataset(self, h5_file, part_files, ranges, n_cols, dtype):
+        """Master file exposing the per-part files as one 'matrix' dataset"""
+        n_rows = ranges[-1][1]
+        layout = h5py.VirtualLayout(shape=(n_rows, n_cols), dtype=dtype)
+        for part_file, (start_row, end_row) in zip(part_files, ranges):
+            # Relative source names resolve against the master file's directory
+            source = h5py.VirtualSource(os.path.basename(part_file), 'matrix',
+                                        shape=(end_row - start_row, n_cols))
+            layout[start_row:end_row, :] = source
+        with h5py.File(h5_file, 'w') as f:
+            f.create_virtual_dataset('matrix', layout)
+    
+    def _record_parallel(self, name, h5_file, layout, part_files, ranges, shape, dtype,
+                         chunks, filter_name, part_leaves):
+        entry = {
+            "type": "parallel_hdf5",
+            "path": str(h5_file),
+            "layout": layout,
+            "shape": list(shape),
+            "dtype": str(dtype),
+            "size_mb": shape[0] * shape[1] * np.dtype(dtype).itemsize / (1024**2),
+            "chunks": list(chunks),
+            "filter": filter_name,
+            "num_parts": len(ranges),
+            "parts": [{"part_id": i, "path": part_files[i], "rows": list(ranges[i])}
+                      for i in range(len(ranges))],
+            "timestamp": datetime.now().isoformat()
+        }
+        self.matrices[name] = self._record_integrity(entry, part_leaves)
+    
+    def load_matrix_parallel(self, name, comm=None, num_workers=None, verify_checksum=True):
+        """
+        Load a matrix saved by save_matrix_parallel
+        
+        With an mpi4py communicator each rank reads only its own row block
+        (for the communicator size the matrix was saved with) and returns it.
+        Without one, a process pool decompresses the parts concurrently into
+        one preallocated shared buffer and the full matrix is returned.
+        """
+        info = self._info(name)
+        if info.get("type") != "parallel_hdf5":
+            raise ValueError(f"Matrix '{name}' was not saved with save_matrix_parallel")
+        
+        shape = tuple(info["shape"])
+        dtype = np.dtype(info["dtype"])
+        parts = info["parts"]
+        
+        if comm is not None:
+            rank, size = comm.Get_rank(), comm.Get_size()
+            start_row, end_row = row_partition(shape[0], size)[rank]
+            if info["layout"] == "mpio" and h5py.get_config().mpi:
+                with h5py.File(info["path"], 'r', driver='mpio', comm=comm) as f:
+                    dset = f['matrix']
+                    with dset.collective:
+                        block = dset[start_row:end_row, :]
+            else:
+                with h5py.File(info["path"], 'r') as f:
+                    block = f['matrix'][start_row:end_row, :]
+            
+            # Only the slabs this rank read are re-hashed
+            if verify_checksum:
+                self._verify_rows(name, info, block, start_row)
+            return block
+        
+        if info["layout"] == "mpio":
+            with h5py.File(info["path"], 'r') as f:
+                matrix = f['matrix'][:]
+            if verify_checksum:
+                self._verify_rows(name, info, matrix)
+            print(f"[Storage] Loaded matrix '{name}' ({matrix.shape}) from {info['path']}")
+            return matrix
+        
+        nbytes = int(np.prod(shape)) * dtype.itemsize
+        shm = shared_memory.SharedMemory(create=True, size=max(1, nbytes))
+        try:
+            num_workers = num_workers or min(len(parts), os.cpu_count() or 1)
+            with ProcessPoolExecutor(max_workers=num_workers) as pool:
+                algorithm = info["checksum_algorithm"] if verify_checksum else None
+                futures = [pool.submit(_read_part_worker, p["path"], p["rows"][0], p["rows"][1],
+                                       shm.name, shape, dtype.str, algorithm) for p in parts]
+                part_leaves = [f.result() for f in futures]
+            matrix = np.ndarray(shape, dtype=dtype, buffer=shm.buf).copy()
+        finally:
+            shm.close()
+            shm.unlink()
+        
+        # Leaves were hashed by the readers; check them and the root here
+        if verify_checksum:
+            if merkle_root([l for p in parts for l in p["leaves"]]) != info["merkle_root"]:
+                raise ValueError(f"Checksum tree of matrix '{name}' does not match its root")
+            for part, leaves in zip(parts, part_leaves):
+                if leaves != part["leaves"]:
+                    raise ValueError(f"Checksum mismatch for matrix '{name}' part {part['part_id']}")
+        
+        print(f"[Storage] Loaded matrix '{name}' ({matrix.shape}) from {len(parts)} parallel parts")
+        return matrix
+    
+    def save_matrix_distributed(self, matrix, name, num_parts=4, num_workers=None):
         """
         Save matrix in multiple parts for distributed storage
         
+        Parts are written concurrently by an I/O thread pool (np.save drops
+        the GIL while writing), each one fsynced and atomically renamed,
+        into a fresh version directory. The metadata entry is switched to
+        it only once every part has landed, so a crash or a failed part
+        never leaves a half-written matrix registered; the parts of the
+        version it replaces are deleted after the switch.
+        
         Args:
             matrix: numpy array to save
             name: unique identifier
             num_parts: number of parts to split into
+            num_workers: I/O threads (default: one per part, up to the cores)
         """
+        return self._save_parts(name, matrix.shape, matrix.dtype, num_parts, num_workers,
+                                lambda start_row, end_row: matrix[start_row:end_row, :])
+    
+    def _save_parts(self, name, shape, dtype, num_parts, num_workers, read_rows):
+        """save_matrix_distributed for rows produced by read_rows(start, end)"""
+        try:
+            previous = self._info(name)
+        except ValueError:
+            previous = None
         matrix_dir = self.storage_dir / name
         matrix_dir.mkdir(exist_ok=True)
+        version_dir = Path(tempfile.mkdtemp(prefix="v", dir=matrix_dir))
         
-        rows_per_part = matrix.shape[0] // num_parts
+        rows_per_part = shape[0] // num_parts
         parts_info = []
+        algorithm = checksum_algorithm()
+        
+        num_workers = num_workers or min(num_parts, os.cpu_count() or 1)
+        io_pool = ThreadPoolExecutor(max_workers=max(1, num_workers))
+        futures = []
+        
+        def write_part(part_file, start_row, end_row):
+            return _save_npy_atomic(self._write_path(part_file), read_rows(start_row, end_row),
+                                    algorithm)
         
         for i in range(num_parts):
             start_row = i * rows_per_part
-            end_row = matrix.shape[0] if i == num_parts - 1 else (i + 1) * rows_per_part
+            end_row = shape[0] if i == num_parts - 1 else (i + 1) * rows_per_part
             
-            part_matrix = matrix[start_row:end_row, :]
-            part_file = matrix_dir / f"{name}_part{i}.npy"
+            part_shape = (end_row - start_row, shape[1])
+            part_file = version_dir / f"{name}_part{i}.npy"
             
-            np.save(part_file, part_matrix)
+            futures.append(io_pool.submit(write_part, part_file, start_row, end_row))
             
             parts_info.append({
                 "part_id": i,
                 "path": str(part_file),
                 "rows": [start_row, end_row],
-                "shape": part_matrix.shape,
-                "size_mb": part_matrix.nbytes / (1024**2)
+                "shape": part_shape,
+                "size_mb": part_shape[0] * part_shape[1] * np.dtype(dtype).itemsize / (1024**2)
             })
         
+        try:
+            part_leaves = [fut.result() for fut in futures]
+        except BaseException:
+            # Nothing points at this version yet: drop it, keep the old one
+            io_pool.shutdown(wait=True)
+            shutil.rmtree(version_dir, ignore_errors=True)
+            shutil.rmtree(self._write_path(part_file).parent, ignore_errors=True)
+            raise
+        io_pool.shutdown(wait=True)
+        _fsync_dir(self._write_path(part_file).parent)
+        _fsync_dir(matrix_dir)
+        
         # Save metadata
-        self.metadata["matrices"][name] = {
+        entry = {
             "type": "distributed",
-            "shape": matrix.shape,
-            "dtype": str(matrix.dtype),
+            "shape": tuple(shape),
+            "dtype": str(np.dtype(dtype)),
             "num_parts": num_parts,
             "parts": parts_info,
-            "checksum": self._compute_checksum(matrix),
             "timestamp": datetime.now().isoformat()
         }
-        self._save_metadata()
+        self._register(name, self._record_integrity(entry, part_leaves),
+                       [p["path"] for p in parts_info], superseded=previous)
         
         print(f"[Storage] Saved matrix '{name}' in {num_parts} parts")
         return parts_info
     
-    def load_matrix_distributed(self, name, verify_checksum=True):
+    def load_matrix_distributed(self, name, verify_checksum=True, lazy=False, out=None,
+                                num_workers=None):
         """
         Load matrix from distributed parts
         
         Args:
             name: identifier of the matrix
             verify_checksum: whether to verify data integrity
+            lazy: return a DistributedMatrixView over memory-mapped parts
+                  instead of reading everything; slices of it read (and
+                  verify) only the rows and parts they touch
+            out: optional preallocated array to load into
+            num_workers: threads copying parts concurrently
         """
-        if name not in self.metadata["matrices"]:
-            raise ValueError(f"Matrix '{name}' not found in storage")
-        
-        info = self.metadata["matrices"][name]
+        info = self._info(name)
         
         if info.get("type") != "distributed":
             raise ValueError(f"Matrix '{name}' is not stored in distributed format")
         
-        # Load all parts
-        parts = []
-        for part_info in info["parts"]:
-            part_file = Path(part_info["path"])
-            if not part_file.exists():
-                raise FileNotFoundError(f"Part file not found: {part_file}")
-            parts.append(np.load(part_file))
+        if lazy:
+            verify = None
+            if verify_checksum:
+                verify = lambda block, start_row: self._verify_rows(name, info, block, start_row)
+            # Only the parts a slice touches are mirrored into the cache
+            source = self.cache.resolve if self.cache is not None else None
+            return DistributedMatrixView(name, info, verify, source)
         
-        # Concatenate parts
-        matrix = np.vstack(parts)
+        # Parts are copied straight into one buffer: no per-part arrays to stack
+        def read(source):
+            view = DistributedMatrixView(name, info, source=source)
+            return view.read(out=out, num_workers=num_workers)
         
-        # Verify checksum
-        if verify_checksum:
-            checksum = self._compute_checksum(matrix)
-            if checksum != info["checksum"]:
-                raise ValueError(f"Checksum mismatch for matrix '{name}'")
+        def verify(matrix):
+            if verify_checksum:
+                self._verify_rows(name, info, matrix)
+        
+        matrix = self._read_validated(name, [p["path"] for p in info["parts"]], read, verify)
         
         print(f"[Storage] Loaded distributed matrix '{name}' ({matrix.shape})")
         return matrix
     
+    def save_matrix_tiled(self, matrix, name, tile=DEFAULT_STORE_TILE):
+        """
+        Save matrix in the tiled layout: every tile x tile block is contiguous
+        on disk, so 2D blocks and column panels are read without touching
+        every row. Each tile gets a leaf checksum under a Merkle root.
+        """
+        return self._save_tiled(name, matrix.shape, matrix.dtype, tile,
+                                lambda start_row, end_row: matrix[start_row:end_row, :])
+    
+    def _save_tiled(self, name, shape, dtype, tile, read_rows):
+        """save_matrix_tiled for rows produced by read_rows(start, end), one tile row at a time"""
+        matrix_dir = self.storage_dir / name
+        matrix_dir.mkdir(exist_ok=True)
+        tiles_file = matrix_dir / f"{name}.tiles"
+        target = self._write_path(tiles_file)
+        tmp_file = target.with_name(target.name + ".tmp")
+        
+        rows, cols = shape
+        tiles = create_tiles(tmp_file, rows, cols, tile, dtype)
+        algorithm = checksum_algorithm()
+        leaf_futures = []
+        for ti in range(tiles.shape[0]):
+            band = read_rows(ti * tile, min((ti + 1) * tile, rows))
+            for tj in range(tiles.shape[1]):
+                block = band[:, tj * tile:(tj + 1) * tile]
+                tiles[ti, tj, :block.shape[0], :block.shape[1]] = block
+                leaf_futures.append(_hash_pool_instance().submit(leaf_hash, tiles[ti, tj], algorithm))
+        leaves = [fut.result() for fut in leaf_futures]
+        tiles.flush()
+        del tiles
+        with open(tmp_file, 'rb+') as f:
+            os.fsync(f.fileno())
+        os.replace(tmp_file, target)
+        
+        entry = {
+            "type": "tiled",
+            "path": str(tiles_file),
+            "shape": [rows, cols],
+            "dtype": str(np.dtype(dtype)),
+            "tile": tile,
+            "size_mb": rows * cols * np.dtype(dtype).itemsize / (1024**2),
+            "checksum_algorithm": algorithm,
+            "leaves": leaves,  # One per tile, tile-major
+            "merkle_root": merkle_root(leaves),
+            "timestamp": datetime.now().isoformat()
+        }
+        self._register(name, entry, [tiles_file])
+        print(f"[Storage] Saved matrix '{name}' ({rows}, {cols}) in {tile}x{tile} tiles")
+        return str(tiles_file)
+    
+    def load_matrix_tiled(self, name, rows=None, cols=None, verify_checksum=True):
+        """
+        Load a block of a tiled matrix
+        
+        Args:
+            name: identifier of the matrix
+            rows, cols: slices (step 1) selecting the block; default all
+            verify_checksum: verify every tile the block touches
+        """
+        info = self._info(name)
+        if info.get("type") != "tiled":
+            raise ValueError(f"Matrix '{name}' is not stored in the tiled layout")
+        bounds = block_bounds(rows, cols, info["shape"])
+        if verify_checksum and merkle_root(info["leaves"]) != info["merkle_root"]:
+            raise ValueError(f"Checksum tree of matrix '{name}' does not match its root")
+        
+        def read(source):
+            tiles, _, _, tile = open_tiles(source(info["path"]))
+            
+            def fetch_tile(ti, tj):
+                # The whole tile is one sequential read
+                block = np.array(tiles[ti, tj])
+                if verify_checksum:
+                    leaf = info["leaves"][ti * tiles.shape[1] + tj]
+                    if leaf_hash(block, info["checksum_algorithm"]) != leaf:
+                        raise ValueError(f"Checksum mismatch for matrix '{name}' "
+                                         f"tile ({ti}, {tj})")
+                return block
+            
+            return assemble_block(bounds, tile, tiles.dtype, fetch_tile)
+        
+        return self._read_validated(name, [info["path"]], read, lambda block: None)
+    
+    def convert_layout(self, name, new_name, layout, tile=DEFAULT_STORE_TILE, num_parts=4):
+        """
+        Rewrite a stored matrix in another on-disk layout, one band at a time
+        
+        Args:
+            name: source matrix (any format)
+            new_name: identifier for the converted copy
+            layout: "tiled" (save_matrix_tiled) or "rows" (save_matrix_distributed parts)
+            tile: tile edge for "tiled"
+            num_parts: part count for "rows"
+        """
+        info = self._info(name)
+        shape, dtype = tuple(info["shape"]), np.dtype(info["dtype"])
+        
+        if info.get("type") == "tiled":
+            read_rows = lambda start, end: self.load_matrix_tiled(name, rows=slice(start, end))
+        elif info.get("type") == "distributed":
+            view = self.load_matrix_distributed(name, lazy=True)
+            read_rows = lambda start, end: view[start:end]
+        else:
+            h5 = h5py.File(info["path"], 'r')
+            read_rows = lambda start, end: h5['matrix'][start:end]
+        
+        try:
+            if layout == "tiled":
+                return self._save_tiled(new_name, shape, dtype, tile, read_rows)
+            if layout == "rows":
+                # One writer bounds memory to a single part
+                return self._save_parts(new_name, shape, dtype, num_parts, 1, read_rows)
+            raise ValueError(f"Unknown layout: {layout}")
+        finally:
+            if info.get("type") not in ("tiled", "distributed"):
+                h5.close()
+    
+    # ----- Versioned snapshots -----
+    #
+    # A snapshot chain keeps successive versions of one matrix name. Each
+    # version is a list of content-addressed tiles (objects/<hash>), so a new
+    # version only writes the tiles whose contents changed; unchanged tiles
+    # are shared with earlier versions through reference counts in the
+    # metadata store.
+    
+    def _object_path(self, digest):
+        return self.storage_dir / "objects" / digest[:2] / digest[2:]
+    
+    def _write_object(self, digest, block):
+        """Store one tile object (no-op if present); returns bytes written"""
+        path = self._object_path(digest)
+        if path.exists():
+            return 0
+        path.parent.mkdir(parents=True, exist_ok=True)
+        tmp_file = path.with_name(f"{path.name}.{os.getpid()}.{threading.get_ident()}.tmp")
+        with open(tmp_file, 'wb') as f:
+            f.write(np.ascontiguousarray(block).data)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_file, path)
+        return block.nbytes
+    
+    def save_snapshot(self, matrix, name, tile=DEFAULT_STORE_TILE, message=None):
+        """
+        Save matrix as the next version of name's snapshot chain
+        
+        Tiles are hashed in parallel; only tiles not already stored (by any
+        version of any chain) are written. Returns the new version number.
+        """
+        rows, cols = matrix.shape
+        grid = (-(-rows // tile), -(-cols // tile))
+        
+        def extract(index):
+            ti, tj = divmod(index, grid[1])
+            block = np.zeros((tile, tile), dtype=matrix.dtype)
+            src = matrix[ti * tile:(ti + 1) * tile, tj * tile:(tj + 1) * tile]
+            block[:src.shape[0], :src.shape[1]] = src
+            return block
+        
+        def hash_and_store(index):
+            block = extract(index)
+            digest = tile_digest(block)
+            if self.matrices.has_tile(digest):
+                return digest, 0
+            return digest, self._write_object(digest, block)
+        
+        results = list(_hash_pool_instance().map(hash_and_store, range(grid[0] * grid[1])))
+        tiles = [digest for digest, _ in results]
+        written = sum(nbytes for _, nbytes in results)
+        
+        def ensure_tile(index):
+            nonlocal written
+            written += self._write_object(tiles[index], extract(index))
+        
+        info = {
+            "shape": [rows, cols],
+            "dtype": str(matrix.dtype),
+            "tile": tile,
+            "tile_bytes": tile * tile * matrix.dtype.itemsize,
+            "message": message
+        }
+        version, new_tiles = self.matrices.add_snapshot(name, info, tiles, info["tile_bytes"],
+                                                        ensure_tile)
+        print(f"[Storage] Snapshot '{name}' v{version}: {new_tiles}/{len(tiles)} tiles new "
+              f"({written / 1024**2:.2f} MB written)")
+        return version
+    
+    def load_snapshot(self, name, version=None, rows=None, cols=None, verify_checksum=True):
+        """
+        Reassemble a snapshot version (default: the latest), or a block of it
+        
+        Args:
+            name: snapshot chain
+            version: version number
+            rows, cols: contiguous slices selecting a block; default all
+            verify_checksum: re-hash every tile read against its address
+        """
+        try:
+            version, info, tiles = self.matrices.get_snapshot(name, version)
+        except KeyError:
+            raise ValueError(f"Snapshot '{name}' version {version} not found") from None
+        shape, tile, dtype = info["shape"], info["tile"], np.dtype(info["dtype"])
+        grid_cols = -(-shape[1] // tile)
+        
+        def fetch_tile(ti, tj):
+            digest = tiles[ti * grid_cols + tj]
+            block = np.fromfile(self._object_path(digest), dtype=dtype).reshape(tile, tile)
+            if verify_checksum and tile_digest(block) != digest:
+                raise ValueError(f"Tile ({ti}, {tj}) of snapshot '{name}' v{version} "
+                                 f"does not match its hash")
+            return block
+        
+        num_workers = min(len(tiles), os.cpu_count() or 1)
+        with ThreadPoolExecutor(max_workers=max(1, num_workers)) as pool:
+            return assemble_block(block_bounds(rows, cols, shape), tile, dtype, fetch_tile, pool)
+    
+    def list_snapshots(self, name):
+        """Versions of a snapshot chain, oldest first"""
+        return self.matrices.list_snapshots(name)
+    
+    def delete_snapshot(self, name, version):
+        """Delete one version; tiles no other version uses are removed"""
+        def remove_tile(digest):
+            path = self._object_path(digest)
+            if path.exists():
+                path.unlink()
+        
+        try:
+            self.matrices.drop_snapshot(name, version, remove_tile)
+        except KeyError:
+            raise ValueError(f"Snapshot '{name}' version {version} not found") from None
+        print(f"[Storage] Deleted snapshot '{name}' v{version}")
+    
     def list_matrices(self):
         """List all stored matrices"""
         print("\n" + "="*60)
         print("Stored Matrices")
         print("="*60)
         
-        for name, info in self.metadata["matrices"].items():
+        matrices = dict(self.matrices.items())
+        for name, info in matrices.items():
             print(f"\nName: {name}")
             print(f"  Shape: {info['shape']}")
             print(f"  Type: {info.get('type', 'single')}")
             print(f"  Size: {info.get('size_mb', 0):.2f} MB")
             print(f"  Timestamp: {info['timestamp']}")
             
-            if info.get('type') == 'distributed':
+            if info.get('type') in ('distributed', 'parallel_hdf5'):
                 print(f"  Parts: {info['num_parts']}")
+            elif info.get('type') == 'tiled':
+                print(f"  Tile: {info['tile']}")
         
         print("="*60)
-        return self.metadata["matrices"]
+        return matrices
     
     def delete_matrix(self, name):
-        """Delete matrix from storage"""
-        if name not in self.metadata["matrices"]:
-            raise ValueError(f"Matrix '{name}' not found")
-        
-        info = self.metadata["matrices"][name]
-        
-        # Delete files
-        if info.get("type") == "distributed":
-            for part_info in info["parts"]:
-                part_file = Path(part_info["path"])
-                if part_file.exists():
-                    part_file.unlink()
-        else:
-            h5_file = Path(info["path"])
-            if h5_file.exists():
-                h5_file.unlink()
+        """
+        Delete matrix from storage
+        
+        A write-back entry whose copy to shared storage failed is deleted
+        too: its cached files and its pending drain are dropped, along with
+        any older version of the name still registered.
+        """
+        self._info(name)
+        with self._draining_lock:
+            draining = name in self._draining
+        if draining:
+            try:
+                self.drain()  # Its files are still being copied to shared storage
+            except OSError:
+                pass  # Its copy failed; the cached files are dropped below
+        
+        with self._draining_lock:
+            entries = [self._draining.pop(name, None), self.matrices.get(name)]
+        for info in filter(None, entries):
+            paths = self._entry_files(info)
+            for path in paths:
+                Path(path).unlink(missing_ok=True)
+            if info.get("type") == "distributed":
+                try:
+                    Path(paths[0]).parent.rmdir()  # Its version directory
+                except OSError:
+                    pass
+            if self.cache is not None:
+                self.cache.discard(paths)
         
         # Remove from metadata
-        del self.metadata["matrices"][name]
-        self._save_metadata()
+        self.matrices.pop(name, None)
         
         print(f"[Storage] Deleted matrix '{name}'")
     
     def get_storage_stats(self):
         """Get storage statistics"""
-        total_size = 0
-        num_matrices = len(self.metadata["matrices"])
-        
-        for info in self.metadata["matrices"].values():
-            total_size += info.get("size_mb", 0)
+        total_size = self.matrices.total_size_mb()
+        num_matrices = len(self.matrices)
         
         stats = {
             "total_matrices": num_matrices,
@@ -259,6 +1611,13 @@ class DistributedStorageManager:
             "storage_dir": str(self.storage_dir),
             "compression": self.compression
         }
+        versions, logical, stored = self.matrices.snapshot_usage()
+        if versions:
+            stats.update({"snapshot_versions": versions,
+                          "snapshot_logical_mb": logical / (1024**2),
+                          "snapshot_stored_mb": stored / (1024**2)})
+        if self.cache is not None:
+            stats.update(self.cache.stats())
         
         return stats
 
@@ -281,23 +1640,29 @@ def main():
     print("\n[3] Saving as distributed parts...")
     storage.save_matrix_distributed(test_matrix, "test_matrix_distributed", num_parts=4)
     
+    # Save with parallel chunked HDF5 writers
+    print("\n[4] Saving with parallel chunked HDF5 writers...")
+    storage.save_matrix_parallel(test_matrix, "test_matrix_parallel")
+    
     # List matrices
-    print("\n[4] Listing stored matrices...")
+    print("\n[5] Listing stored matrices...")
     storage.list_matrices()
     
     # Load matrix
-    print("\n[5] Loading matrices...")
+    print("\n[6] Loading matrices...")
     loaded_single = storage.load_matrix("test_matrix_single")
     loaded_distributed = storage.load_matrix_distributed("test_matrix_distributed")
+    loaded_parallel = storage.load_matrix_parallel("test_matrix_parallel")
     
     # Verify
-    print("\n[6] Verifying data integrity...")
+    print("\n[7] Verifying data integrity...")
     assert np.allclose(test_matrix, loaded_single), "Single file verification failed"
     assert np.allclose(test_matrix, loaded_distributed), "Distributed file verification failed"
+    assert np.array_equal(test_matrix, loaded_parallel), "Parallel file verification failed"
     print("✓ Data integrity verified")
     
     # Storage stats
-    print("\n[7] Storage statistics:")
+    print("\n[8] Storage statistics:")
     stats = storage.get_storage_stats()
     for key, value in stats.items():
         print(f"  {key}: {value}")
@@ -13,16 +13,78 @@
 #include <vector>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <chrono>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cerrno>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#else
+#include <zlib.h>
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_DISPATCH 1
+#endif
 
 using namespace std;
 using namespace std::chrono;
 
 const int MATRIX_SIZE = 4096;
+const int INVERSE_SIZE = 512;
+
+// Phase markers for an external monitor (--phase-log=<file>): each rank
+// appends "<unix time> <rank> begin|end <operation>" as a ResourceMonitor
+// starts and stops, so per-process samples can be attributed to phases.
+// One write() per line on an O_APPEND descriptor keeps ranks' lines whole.
+struct PhaseLog {
+    int fd;
+    int rank;
+};
+PhaseLog g_phase_log = {-1, 0};
+
+void phase_log_open(const string& path, int rank) {
+    g_phase_log.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    g_phase_log.rank = rank;
+    if (g_phase_log.fd < 0) {
+        cerr << "Rank " << rank << ": cannot open phase log " << path << endl;
+    }
+}
+
+void phase_mark(const char* event, const string& operation) {
+    if (g_phase_log.fd < 0) return;
+    double now = duration<double>(system_clock::now().time_since_epoch()).count();
+    char line[256];
+    int length = snprintf(line, sizeof(line), "%.6f %d %s %s\n", now, g_phase_log.rank,
+                          event, operation.c_str());
+    if (length > 0 && write(g_phase_log.fd, line, min(length, (int)sizeof(line) - 1)) < 0) {
+        close(g_phase_log.fd);
+        g_phase_log.fd = -1;
+    }
+}
+
+void phase_log_close() {
+    if (g_phase_log.fd >= 0) close(g_phase_log.fd);
+    g_phase_log.fd = -1;
+}
 
 class ResourceMonitor {
 private:
@@ -32,21 +94,24 @@ private:
     
 public:
     ResourceMonitor(string op_name) : operation_name(op_name) {
+        phase_mark("begin", operation_name);
         start_time = MPI_Wtime();
     }
     
     double stop() {
         end_time = MPI_Wtime();
+        phase_mark("end", operation_name);
         return end_time - start_time;
     }
     
-    void log_metrics(int rank, int size, double elapsed_time, const string& filename) {
+    void log_metrics(int rank, int size, double elapsed_time, const string& filename,
+                     int matrix_size = MATRIX_SIZE) {
         if (rank == 0) {
             ofstream logfile(filename, ios::app);
             logfile << operation_name << "," 
                     << size << "," 
                     << elapsed_time << "," 
-                    << MATRIX_SIZE << endl;
+                    << matrix_size << endl;
             logfile.close();
         }
     }
@@ -62,185 +127,3980 @@ void initialize_matrix(double* matrix, int rows, int cols) {
     }
 }
 
-// Initialize identity matrix
-void initialize_identity(double* matrix, int size) {
-    #pragma omp parallel for collapse(2)
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            matrix[i * size + j] = (i == j) ? 1.0 : 0.0;
+// Initialize identity matrix
+void initialize_identity(double* matrix, int size) {
+    #pragma omp parallel for collapse(2)
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            matrix[i * size + j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+}
+
+// ===== Topology-aware collectives =====
+//
+// Ranks are grouped into shared-memory nodes (MPI_Comm_split_type) with one
+// leader per node. When the job spans several multi-rank nodes, broadcasts
+// and allgathers run in two levels: within a node over shared memory, and
+// between nodes among the leaders only, so each inter-node link carries the
+// data once per node instead of once per rank.
+
+struct Topology {
+    bool initialized;
+    bool hierarchical;          // Two-level collectives enabled
+    MPI_Comm node_comm;         // Ranks on this node
+    MPI_Comm leader_comm;       // Node leaders (MPI_COMM_NULL on non-leaders)
+    int node_rank, node_size;
+    int node_id, num_nodes;
+    int node_offset;            // Ranks on nodes before this one
+    bool node_contiguous;       // Each node holds a contiguous block of world ranks
+    vector<int> rank_node;      // World rank -> node id
+    vector<int> rank_node_rank; // World rank -> rank within its node
+    
+    Topology() : initialized(false), hierarchical(false),
+                 node_comm(MPI_COMM_NULL), leader_comm(MPI_COMM_NULL),
+                 node_rank(0), node_size(1), node_id(0), num_nodes(1),
+                 node_offset(0), node_contiguous(true) {}
+};
+
+static Topology g_topology;
+
+// Build the topology from a given node communicator
+void topology_init_from(MPI_Comm node_comm, bool hierarchical) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    
+    Topology& t = g_topology;
+    t.node_comm = node_comm;
+    MPI_Comm_rank(node_comm, &t.node_rank);
+    MPI_Comm_size(node_comm, &t.node_size);
+    
+    MPI_Comm_split(MPI_COMM_WORLD, (t.node_rank == 0) ? 0 : MPI_UNDEFINED,
+                   rank, &t.leader_comm);
+    if (t.leader_comm != MPI_COMM_NULL) {
+        MPI_Comm_rank(t.leader_comm, &t.node_id);
+        MPI_Comm_size(t.leader_comm, &t.num_nodes);
+    }
+    MPI_Bcast(&t.node_id, 1, MPI_INT, 0, node_comm);
+    MPI_Bcast(&t.num_nodes, 1, MPI_INT, 0, node_comm);
+    
+    t.rank_node.resize(size);
+    t.rank_node_rank.resize(size);
+    MPI_Allgather(&t.node_id, 1, MPI_INT, t.rank_node.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    MPI_Allgather(&t.node_rank, 1, MPI_INT, t.rank_node_rank.data(), 1, MPI_INT,
+                  MPI_COMM_WORLD);
+    
+    t.node_contiguous = true;
+    for (int p = 1; p < size; p++) {
+        if (t.rank_node[p] != t.rank_node[p - 1] && t.rank_node[p] != t.rank_node[p - 1] + 1) {
+            t.node_contiguous = false;
+        }
+        if (t.rank_node[p] == t.rank_node[p - 1] &&
+            t.rank_node_rank[p] != t.rank_node_rank[p - 1] + 1) {
+            t.node_contiguous = false;
+        }
+    }
+    
+    t.node_offset = 0;
+    for (int p = 0; p < size; p++) {
+        if (t.rank_node[p] < t.node_id) t.node_offset++;
+    }
+    
+    t.hierarchical = hierarchical && t.num_nodes > 1 && t.num_nodes < size;
+    t.initialized = true;
+}
+
+void topology_init(bool hierarchical) {
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    topology_init_from(node_comm, hierarchical);
+}
+
+void topology_free() {
+    Topology& t = g_topology;
+    if (t.leader_comm != MPI_COMM_NULL) MPI_Comm_free(&t.leader_comm);
+    if (t.node_comm != MPI_COMM_NULL) MPI_Comm_free(&t.node_comm);
+    t = Topology();
+}
+
+// MPI_Bcast over MPI_COMM_WORLD, two-level when the topology allows it
+void hier_bcast(void* buf, int count, MPI_Datatype type, int root) {
+    const Topology& t = g_topology;
+    if (!t.hierarchical) {
+        MPI_Bcast(buf, count, type, root, MPI_COMM_WORLD);
+        return;
+    }
+    
+    int root_node = t.rank_node[root];
+    if (t.node_id == root_node) {
+        MPI_Bcast(buf, count, type, t.rank_node_rank[root], t.node_comm);
+    }
+    if (t.leader_comm != MPI_COMM_NULL) {
+        MPI_Bcast(buf, count, type, root_node, t.leader_comm);
+    }
+    if (t.node_id != root_node) {
+        MPI_Bcast(buf, count, type, 0, t.node_comm);
+    }
+}
+
+// In-place MPI_Allgatherv of doubles over MPI_COMM_WORLD. The two-level
+// version needs each node's blocks to be adjacent in the buffer.
+void hier_allgatherv(double* buf, const int* counts, const int* displs) {
+    const Topology& t = g_topology;
+    int size = (int)t.rank_node.size();
+    
+    bool adjacent = t.hierarchical && t.node_contiguous;
+    for (int p = 1; adjacent && p < size; p++) {
+        if (displs[p] != displs[p - 1] + counts[p - 1]) adjacent = false;
+    }
+    if (!adjacent) {
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
+                       buf, counts, displs, MPI_DOUBLE, MPI_COMM_WORLD);
+        return;
+    }
+    
+    // Per-node and per-node-member extents
+    int rank = t.node_offset + t.node_rank;
+    vector<int> node_counts(t.num_nodes, 0), node_displs(t.num_nodes, 0);
+    vector<int> member_counts(t.node_size), member_displs(t.node_size);
+    for (int p = 0; p < size; p++) {
+        int node = t.rank_node[p];
+        if (node_counts[node] == 0) node_displs[node] = displs[p];
+        node_counts[node] += counts[p];
+        if (node == t.node_id) {
+            member_counts[t.rank_node_rank[p]] = counts[p];
+            member_displs[t.rank_node_rank[p]] = displs[p];
+        }
+    }
+    
+    // 1. Gather the node's blocks on its leader
+    if (t.node_rank == 0) {
+        MPI_Gatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, buf, member_counts.data(),
+                    member_displs.data(), MPI_DOUBLE, 0, t.node_comm);
+    } else {
+        MPI_Gatherv(buf + displs[rank], counts[rank], MPI_DOUBLE, NULL, NULL, NULL,
+                    MPI_DOUBLE, 0, t.node_comm);
+    }
+    
+    // 2. Exchange whole node blocks among leaders
+    if (t.leader_comm != MPI_COMM_NULL) {
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, buf, node_counts.data(),
+                       node_displs.data(), MPI_DOUBLE, t.leader_comm);
+    }
+    
+    // 3. Leaders share the assembled buffer within the node
+    int total = displs[size - 1] + counts[size - 1] - displs[0];
+    MPI_Bcast(buf + displs[0], total, MPI_DOUBLE, 0, t.node_comm);
+}
+
+// ===== Derived datatype cache =====
+//
+// Strided data (the entries of a strided batch) is described with committed
+// derived types and sent or received in place instead of being packed into
+// temporaries. Each distinct shape is built and committed once and reused
+// for the rest of the run; --batched repeats each batch shape, so every
+// timed run after the first gathers through a cached type.
+
+static map<vector<long>, MPI_Datatype> g_datatype_cache;
+
+static MPI_Datatype cached_datatype(const vector<long>& key, MPI_Datatype type) {
+    MPI_Type_commit(&type);
+    g_datatype_cache[key] = type;
+    return type;
+}
+
+// count contiguous doubles with an extent of stride doubles, so consecutive
+// elements of the type are stride apart (strided batches of matrices)
+MPI_Datatype strided_entry_datatype(int count, long stride) {
+    long k[] = {2, count, stride};
+    vector<long> key(k, k + 3);
+    map<vector<long>, MPI_Datatype>::iterator it = g_datatype_cache.find(key);
+    if (it != g_datatype_cache.end()) return it->second;
+    
+    MPI_Datatype entry, type;
+    MPI_Type_contiguous(count, MPI_DOUBLE, &entry);
+    MPI_Type_create_resized(entry, 0, stride * (MPI_Aint)sizeof(double), &type);
+    MPI_Type_free(&entry);
+    return cached_datatype(key, type);
+}
+
+void datatype_cache_free() {
+    for (map<vector<long>, MPI_Datatype>::iterator it = g_datatype_cache.begin();
+         it != g_datatype_cache.end(); ++it) {
+        MPI_Type_free(&it->second);
+    }
+    g_datatype_cache.clear();
+}
+
+// ===== On-the-wire panel compression =====
+//
+// Panels exchanged by the multiply gather and the inverse allgathers can be
+// compressed before they hit the network:
+//   lossless - byte shuffle (the exponent bytes of neighbouring doubles
+//              line up) followed by LZ4 when built with USE_LZ4=1, zlib
+//              level 1 otherwise
+//   lossy    - error-bounded block quantization: each block of 64 values is
+//              stored as its minimum plus fixed-width offsets in steps of
+//              2 * tolerance, so every value is within the tolerance. Only
+//              final results are sent lossy; the inverse's working replicas
+//              go lossless since their error would compound
+//   auto     - starts uncompressed and switches to lossless compression once
+//              the measured compute time is well below communication time
+
+enum CompressionMode {
+    COMPRESS_NONE,
+    COMPRESS_LOSSLESS,
+    COMPRESS_LOSSY,
+    COMPRESS_AUTO
+};
+
+struct CompressionPolicy {
+    CompressionMode mode;
+    double tolerance;       // Absolute error bound for COMPRESS_LOSSY
+    bool active;            // Compress the next exchanges
+    double comp_time;       // Measured since the last decision
+    double comm_time;
+    
+    CompressionPolicy() : mode(COMPRESS_NONE), tolerance(1e-6), active(false),
+                          comp_time(0.0), comm_time(0.0) {}
+};
+
+static CompressionPolicy g_compression;
+
+// Compression is switched on when compute is below this fraction of comm
+const double AUTO_COMPRESS_RATIO = 0.5;
+const int LOSSY_BLOCK = 64;
+
+// False for an unknown mode name
+bool parse_compression_mode(const string& name, CompressionMode& mode) {
+    if (name == "none") mode = COMPRESS_NONE;
+    else if (name == "lossless") mode = COMPRESS_LOSSLESS;
+    else if (name == "lossy") mode = COMPRESS_LOSSY;
+    else if (name == "auto") mode = COMPRESS_AUTO;
+    else return false;
+    return true;
+}
+
+void compression_configure(CompressionMode mode, double tolerance) {
+    g_compression = CompressionPolicy();
+    g_compression.mode = mode;
+    g_compression.tolerance = tolerance;
+    g_compression.active = (mode == COMPRESS_LOSSLESS || mode == COMPRESS_LOSSY);
+}
+
+// Feed measured times; in auto mode all ranks agree on the decision
+void compression_record(double comp_time, double comm_time) {
+    g_compression.comp_time += comp_time;
+    g_compression.comm_time += comm_time;
+}
+
+void compression_decide() {
+    CompressionPolicy& c = g_compression;
+    if (c.mode != COMPRESS_AUTO) return;
+    double local[2] = {c.comp_time, c.comm_time}, total[2];
+    MPI_Allreduce(local, total, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (total[0] + total[1] > 0.0) {
+        c.active = total[0] < AUTO_COMPRESS_RATIO * total[1];
+    }
+    c.comp_time = 0.0;
+    c.comm_time = 0.0;
+}
+
+struct PanelHeader {
+    uint32_t mode;          // CompressionMode of the payload (NONE = raw)
+    uint32_t reserved;
+    uint64_t count;         // Number of doubles
+    uint64_t payload;       // Payload bytes following the header
+};
+
+// Upper bound on the compressed size of count doubles
+size_t compressed_bound(long count) {
+    size_t raw = (size_t)count * sizeof(double);
+    size_t lossy = raw + ((size_t)count / LOSSY_BLOCK + 1) * (sizeof(double) + 1);
+#ifdef HAVE_LZ4
+    size_t lossless = (size_t)LZ4_compressBound((int)raw);
+#else
+    size_t lossless = (size_t)compressBound((uLong)raw);
+#endif
+    return sizeof(PanelHeader) + max(raw, max(lossy, lossless));
+}
+
+static void lossy_encode(const double* src, long count, double tol, vector<char>& out) {
+    double step = 2.0 * tol;
+    for (long b0 = 0; b0 < count; b0 += LOSSY_BLOCK) {
+        int len = (int)min((long)LOSSY_BLOCK, count - b0);
+        double lo = src[b0], hi = src[b0];
+        for (int i = 1; i < len; i++) {
+            lo = fmin(lo, src[b0 + i]);
+            hi = fmax(hi, src[b0 + i]);
+        }
+        double levels = (hi - lo) / step + 0.5;
+        int bits = 0;
+        if (!(levels < 4.0e15)) {
+            bits = 255;   // Range too wide (or NaN/inf): store raw
+        } else {
+            while (bits < 52 && (double)(1ULL << bits) <= levels) bits++;
+        }
+        
+        const char* lo_bytes = reinterpret_cast<const char*>(&lo);
+        out.insert(out.end(), lo_bytes, lo_bytes + sizeof(double));
+        out.push_back((char)bits);
+        
+        if (bits == 255) {
+            const char* raw = reinterpret_cast<const char*>(&src[b0]);
+            out.insert(out.end(), raw, raw + len * sizeof(double));
+            continue;
+        }
+        
+        // Pack len values of `bits` bits, little-endian bit order
+        uint64_t acc = 0;
+        int nbits = 0;
+        for (int i = 0; i < len; i++) {
+            uint64_t q = (uint64_t)llround((src[b0 + i] - lo) / step);
+            acc |= q << nbits;
+            nbits += bits;
+            while (nbits >= 8) {
+                out.push_back((char)(acc & 0xff));
+                acc >>= 8;
+                nbits -= 8;
+            }
+        }
+        if (nbits > 0) out.push_back((char)(acc & 0xff));
+    }
+}
+
+// False if the payload (of `bytes` bytes) is truncated or malformed
+static bool lossy_decode(const char* in, size_t bytes, long count, double tol, double* dst) {
+    double step = 2.0 * tol;
+    size_t pos = 0;
+    for (long b0 = 0; b0 < count; b0 += LOSSY_BLOCK) {
+        int len = (int)min((long)LOSSY_BLOCK, count - b0);
+        if (pos + sizeof(double) + 1 > bytes) return false;
+        double lo;
+        memcpy(&lo, in + pos, sizeof(double));
+        pos += sizeof(double);
+        int bits = (unsigned char)in[pos++];
+        
+        if (bits == 255) {
+            if (pos + len * sizeof(double) > bytes) return false;
+            memcpy(&dst[b0], in + pos, len * sizeof(double));
+            pos += len * sizeof(double);
+            continue;
+        }
+        if (bits > 52 || pos + ((size_t)len * bits + 7) / 8 > bytes) return false;
+        
+        uint64_t acc = 0;
+        int nbits = 0;
+        uint64_t mask = (bits == 0) ? 0 : ((1ULL << bits) - 1);
+        for (int i = 0; i < len; i++) {
+            while (nbits < bits) {
+                acc |= (uint64_t)(unsigned char)in[pos++] << nbits;
+                nbits += 8;
+            }
+            uint64_t q = acc & mask;
+            acc = (bits == 0) ? acc : (acc >> bits);
+            nbits -= bits;
+            dst[b0 + i] = lo + (double)q * step;
+        }
+    }
+    return pos == bytes;
+}
+
+// Compress count doubles into out (header + payload); returns the size
+size_t compress_panel(const double* src, long count, CompressionMode mode,
+                      double tol, vector<char>& out) {
+    size_t raw = (size_t)count * sizeof(double);
+    out.assign(sizeof(PanelHeader), 0);
+    PanelHeader h;
+    h.mode = mode;
+    h.reserved = 0;
+    h.count = count;
+    
+    if (mode == COMPRESS_LOSSY) {
+        lossy_encode(src, count, tol, out);
+    } else if (mode == COMPRESS_LOSSLESS) {
+        vector<char> shuffled(raw);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+        #pragma omp parallel for
+        for (long i = 0; i < count; i++) {
+            for (int b = 0; b < (int)sizeof(double); b++) {
+                shuffled[(size_t)b * count + i] = bytes[(size_t)i * sizeof(double) + b];
+            }
+        }
+        out.resize(compressed_bound(count));
+#ifdef HAVE_LZ4
+        int packed = LZ4_compress_default(shuffled.data(), &out[sizeof(PanelHeader)],
+                                          (int)raw, (int)(out.size() - sizeof(PanelHeader)));
+        out.resize(sizeof(PanelHeader) + (packed > 0 ? packed : 0));
+        if (packed <= 0) h.mode = COMPRESS_NONE;
+#else
+        uLongf packed = (uLongf)(out.size() - sizeof(PanelHeader));
+        int rc = compress2(reinterpret_cast<Bytef*>(&out[sizeof(PanelHeader)]), &packed,
+                           reinterpret_cast<const Bytef*>(shuffled.data()), (uLong)raw, 1);
+        out.resize(sizeof(PanelHeader) + (rc == Z_OK ? packed : 0));
+        if (rc != Z_OK) h.mode = COMPRESS_NONE;
+#endif
+    } else {
+        h.mode = COMPRESS_NONE;
+    }
+    
+    // Incompressible panels travel raw
+    if (h.mode == COMPRESS_NONE || out.size() - sizeof(PanelHeader) >= raw) {
+        h.mode = COMPRESS_NONE;
+        out.resize(sizeof(PanelHeader));
+        const char* bytes = reinterpret_cast<const char*>(src);
+        out.insert(out.end(), bytes, bytes + raw);
+    }
+    
+    h.payload = out.size() - sizeof(PanelHeader);
+    memcpy(&out[0], &h, sizeof(h));
+    return out.size();
+}
+
+// Decompress a panel produced by compress_panel into dst (count doubles);
+// false if the panel is corrupt
+bool try_decompress_panel(const char* in, double* dst, long count, double tol) {
+    PanelHeader h;
+    memcpy(&h, in, sizeof(h));
+    const char* payload = in + sizeof(PanelHeader);
+    size_t raw = (size_t)h.count * sizeof(double);
+    if ((long)h.count != count) return false;
+    
+    if (h.mode == COMPRESS_LOSSY) {
+        return lossy_decode(payload, h.payload, count, tol, dst);
+    } else if (h.mode == COMPRESS_LOSSLESS) {
+        vector<char> shuffled(raw);
+#ifdef HAVE_LZ4
+        int got = LZ4_decompress_safe(payload, shuffled.data(), (int)h.payload, (int)raw);
+        if (got != (int)raw) return false;
+#else
+        uLongf out_len = (uLongf)raw;
+        int rc = uncompress(reinterpret_cast<Bytef*>(shuffled.data()), &out_len,
+                            reinterpret_cast<const Bytef*>(payload), (uLong)h.payload);
+        if (rc != Z_OK || out_len != (uLongf)raw) return false;
+#endif
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(dst);
+        long count = (long)h.count;
+        #pragma omp parallel for
+        for (long i = 0; i < count; i++) {
+            for (int b = 0; b < (int)sizeof(double); b++) {
+                bytes[(size_t)i * sizeof(double) + b] = shuffled[(size_t)b * count + i];
+            }
+        }
+    } else if (h.mode == COMPRESS_NONE && h.payload == raw) {
+        memcpy(dst, payload, raw);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// A corrupt panel leaves the ranks' replicas inconsistent: stop the job
+void decompress_panel(const char* in, double* dst, long count, double tol) {
+    if (!try_decompress_panel(in, dst, count, tol)) {
+        int rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        cerr << "Rank " << rank << ": corrupt compressed panel" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+// Round trip of the codec on a panel with smooth, random, tiny, huge and
+// non-finite values: lossless must be exact and lossy within tol
+bool compression_round_trip_ok(double tol) {
+    const long count = 4 * LOSSY_BLOCK + 7;
+    vector<double> src(count), back(count);
+    for (long i = 0; i < count; i++) {
+        src[i] = sin(0.01 * i) * 100.0 + (double)((i * 2654435761u) % 1000) * 1e-3;
+    }
+    src[3] = 1e-300;
+    src[LOSSY_BLOCK + 1] = 1e300;
+    src[2 * LOSSY_BLOCK + 5] = -INFINITY;
+    
+    CompressionMode modes[2] = {COMPRESS_LOSSLESS, COMPRESS_LOSSY};
+    for (int m = 0; m < 2; m++) {
+        vector<char> packed;
+        compress_panel(src.data(), count, modes[m], tol, packed);
+        if (!try_decompress_panel(packed.data(), back.data(), count, tol)) return false;
+        for (long i = 0; i < count; i++) {
+            bool exact = memcmp(&src[i], &back[i], sizeof(double)) == 0;
+            if (modes[m] == COMPRESS_LOSSLESS ? !exact
+                                              : !(exact || fabs(src[i] - back[i]) <= tol)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Mode used for the next exchange (auto compresses losslessly). State that
+// is fed back into later iterations passes allow_lossy = false: the error
+// would compound instead of staying within the tolerance.
+static inline CompressionMode active_compression(bool allow_lossy = true) {
+    if (!g_compression.active) return COMPRESS_NONE;
+    return (g_compression.mode == COMPRESS_LOSSY && allow_lossy) ? COMPRESS_LOSSY
+                                                                 : COMPRESS_LOSSLESS;
+}
+
+// In-place allgatherv of doubles with compressed blocks. With lossy mode
+// the sender also keeps the decoded copy of its block, so every rank holds
+// bit-identical data.
+void allgatherv_compressed(double* buf, const int* counts, const int* displs,
+                           int rank, int size, CompressionMode mode) {
+    vector<char> packed;
+    compress_panel(buf + displs[rank], counts[rank], mode, g_compression.tolerance, packed);
+    if (mode == COMPRESS_LOSSY) {
+        decompress_panel(packed.data(), buf + displs[rank], counts[rank], g_compression.tolerance);
+    }
+    
+    int my_bytes = (int)packed.size();
+    vector<int> byte_counts(size), byte_displs(size);
+    MPI_Allgather(&my_bytes, 1, MPI_INT, byte_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int total = 0;
+    for (int p = 0; p < size; p++) {
+        byte_displs[p] = total;
+        total += byte_counts[p];
+    }
+    
+    vector<char> all(total);
+    MPI_Allgatherv(packed.data(), my_bytes, MPI_BYTE, all.data(), byte_counts.data(),
+                   byte_displs.data(), MPI_BYTE, MPI_COMM_WORLD);
+    
+    for (int p = 0; p < size; p++) {
+        if (p != rank) {
+            decompress_panel(&all[byte_displs[p]], buf + displs[p], counts[p],
+                             g_compression.tolerance);
+        }
+    }
+}
+
+// Gather row-striped slices of C onto rank 0
+template <typename T>
+void gather_rows_to_root(T* C, MPI_Datatype type, int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    if (rank == 0) {
+        for (int p = 1; p < size; p++) {
+            int p_start = p * rows_per_proc;
+            int p_end = (p == size - 1) ? n : p_start + rows_per_proc;
+            int count = (p_end - p_start) * n;
+            
+            MPI_Recv(&C[p_start * n], count, type, p, 0, 
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    } else {
+        int count = (end_row - start_row) * n;
+        MPI_Send(&C[start_row * n], count, type, 0, 0, MPI_COMM_WORLD);
+    }
+}
+
+void gather_rows_to_root(double* C, int rank, int size, int n) {
+    gather_rows_to_root(C, MPI_DOUBLE, rank, size, n);
+}
+
+// Where a distributed result ends up
+enum OutputDistribution {
+    OUTPUT_DISTRIBUTED,   // Each rank keeps only its own rows
+    OUTPUT_ROOT,          // Full result on rank 0
+    OUTPUT_ALLGATHER      // Full result on every rank
+};
+
+bool parse_output_distribution(const string& name, OutputDistribution& output) {
+    if (name == "distributed") output = OUTPUT_DISTRIBUTED;
+    else if (name == "root") output = OUTPUT_ROOT;
+    else if (name == "allgather") output = OUTPUT_ALLGATHER;
+    else return false;
+    return true;
+}
+
+// Replicate row-striped slices of C on every rank
+void allgather_rows(double* C, int rank, int size, int n, bool allow_lossy = true) {
+    int rows_per_proc = n / size;
+    vector<int> counts(size), displs(size);
+    for (int p = 0; p < size; p++) {
+        int p_start = p * rows_per_proc;
+        int p_end = (p == size - 1) ? n : p_start + rows_per_proc;
+        counts[p] = (p_end - p_start) * n;
+        displs[p] = p_start * n;
+    }
+    if (g_compression.active) {
+        allgatherv_compressed(C, counts.data(), displs.data(), rank, size,
+                              active_compression(allow_lossy));
+    } else {
+        hier_allgatherv(C, counts.data(), displs.data());
+    }
+}
+
+// Collect row-striped slices of C according to the requested distribution
+void collect_rows(double* C, OutputDistribution output, int rank, int size, int n) {
+    if (output == OUTPUT_ROOT) {
+        gather_rows_to_root(C, rank, size, n);
+    } else if (output == OUTPUT_ALLGATHER) {
+        allgather_rows(C, rank, size, n);
+    }
+}
+
+// Rows of C computed and sent per chunk in the streamed gather
+const int GATHER_CHUNK_ROWS = 64;
+
+// Matrix multiplication using MPI + OpenMP
+// C is computed in row chunks. With OUTPUT_ROOT each finished chunk is sent
+// with MPI_Isend while the next one is computed, and rank 0 pre-posts every
+// receive so chunks complete in arrival order; most of the gather hides
+// behind compute. OUTPUT_DISTRIBUTED leaves each rank with only its rows.
+// When panel compression is active the chunks travel compressed and rank 0
+// decompresses each one as it arrives.
+void matrix_multiply_mpi(double* A, double* B, double* C, 
+                         int rank, int size, int n,
+                         OutputDistribution output = OUTPUT_ROOT) {
+    
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    bool stream_to_root = (output == OUTPUT_ROOT);
+    CompressionMode compress = active_compression();
+    double comp_time = 0.0;
+    double comm_start = MPI_Wtime();
+    
+    // Rank 0 posts the receives for every chunk of every other rank
+    vector<MPI_Request> requests;
+    vector<int> recv_rows;                  // First row of each received chunk
+    vector<int> recv_counts;                // Its number of rows
+    vector<vector<char> > packed;           // Compressed chunk buffers
+    if (rank == 0 && stream_to_root) {
+        for (int p = 1; p < size; p++) {
+            int p_start = p * rows_per_proc;
+            int p_end = (p == size - 1) ? n : p_start + rows_per_proc;
+            for (int r0 = p_start, tag = 0; r0 < p_end; r0 += GATHER_CHUNK_ROWS, tag++) {
+                int rows = min(GATHER_CHUNK_ROWS, p_end - r0);
+                MPI_Request req;
+                if (compress != COMPRESS_NONE) {
+                    packed.push_back(vector<char>(compressed_bound((long)rows * n)));
+                    MPI_Irecv(packed.back().data(), (int)packed.back().size(), MPI_BYTE,
+                              p, tag, MPI_COMM_WORLD, &req);
+                } else {
+                    MPI_Irecv(&C[r0 * n], rows * n, MPI_DOUBLE, p, tag,
+                              MPI_COMM_WORLD, &req);
+                }
+                requests.push_back(req);
+                recv_rows.push_back(r0);
+                recv_counts.push_back(rows);
+            }
+        }
+    }
+    
+    for (int r0 = start_row, tag = 0; r0 < end_row; r0 += GATHER_CHUNK_ROWS, tag++) {
+        int r1 = min(r0 + GATHER_CHUNK_ROWS, end_row);
+        double chunk_start = MPI_Wtime();
+        
+        // Local computation with OpenMP
+        #pragma omp parallel for collapse(2)
+        for (int i = r0; i < r1; i++) {
+            for (int j = 0; j < n; j++) {
+                double sum = 0.0;
+                for (int k = 0; k < n; k++) {
+                    sum += A[i * n + k] * B[k * n + j];
+                }
+                C[i * n + j] = sum;
+            }
+        }
+        comp_time += MPI_Wtime() - chunk_start;
+        
+        if (rank != 0 && stream_to_root) {
+            MPI_Request req;
+            if (compress != COMPRESS_NONE) {
+                packed.push_back(vector<char>());
+                compress_panel(&C[r0 * n], (long)(r1 - r0) * n, compress,
+                               g_compression.tolerance, packed.back());
+                MPI_Isend(packed.back().data(), (int)packed.back().size(), MPI_BYTE,
+                          0, tag, MPI_COMM_WORLD, &req);
+            } else {
+                MPI_Isend(&C[r0 * n], (r1 - r0) * n, MPI_DOUBLE, 0, tag,
+                          MPI_COMM_WORLD, &req);
+            }
+            requests.push_back(req);
+        }
+        
+        // Drive progress of the outstanding transfers between chunks
+        if (!requests.empty()) {
+            int done;
+            MPI_Testall((int)requests.size(), requests.data(), &done,
+                        MPI_STATUSES_IGNORE);
+        }
+    }
+    
+    if (rank == 0 && compress != COMPRESS_NONE) {
+        // Decompress chunks in arrival order
+        for (size_t c = 0; c < requests.size(); c++) {
+            int idx;
+            MPI_Waitany((int)requests.size(), requests.data(), &idx, MPI_STATUS_IGNORE);
+            decompress_panel(packed[idx].data(), &C[recv_rows[idx] * n],
+                             (long)recv_counts[idx] * n, g_compression.tolerance);
+        }
+    } else {
+        MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    }
+    
+    if (output == OUTPUT_ALLGATHER) {
+        allgather_rows(C, rank, size, n);
+    }
+    
+    compression_record(comp_time, MPI_Wtime() - comm_start - comp_time);
+    compression_decide();
+}
+
+// ===== Distributed-memory ring multiply =====
+//
+// 1D systolic variant of the row-striped multiply: every rank keeps only
+// its row block of A, B and C (O(n^2/P) memory instead of three full
+// matrices) and the row blocks of B travel around the ring. The shift of
+// the next block is in flight while the current one is applied, so sizes
+// that only fit once distributed can still be multiplied. C stays
+// distributed.
+
+static inline int block_rows(int p, int rows_per_proc, int size, int n) {
+    return (p == size - 1) ? n - p * rows_per_proc : rows_per_proc;
+}
+
+// A_local, B_local and C_local hold this rank's rows (row-major, n columns)
+void matrix_multiply_ring_mpi(const double* A_local, const double* B_local, double* C_local,
+                              int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int local_rows = block_rows(rank, rows_per_proc, size, n);
+    int max_rows = block_rows(size - 1, rows_per_proc, size, n);
+    int left = (rank - 1 + size) % size;
+    int right = (rank + 1) % size;
+    
+    vector<double> current((size_t)max_rows * n), incoming((size_t)max_rows * n);
+    memcpy(current.data(), B_local, (size_t)local_rows * n * sizeof(double));
+    memset(C_local, 0, (size_t)local_rows * n * sizeof(double));
+    
+    int block = rank;
+    for (int step = 0; step < size; step++) {
+        int next_block = (block + 1) % size;
+        MPI_Request requests[2];
+        int num_requests = 0;
+        if (step < size - 1) {
+            MPI_Irecv(incoming.data(), block_rows(next_block, rows_per_proc, size, n) * n,
+                      MPI_DOUBLE, right, step, MPI_COMM_WORLD, &requests[num_requests++]);
+            MPI_Isend(current.data(), block_rows(block, rows_per_proc, size, n) * n,
+                      MPI_DOUBLE, left, step, MPI_COMM_WORLD, &requests[num_requests++]);
+        }
+        
+        // C_local += A_local[:, block columns] * B_block
+        int k0 = block * rows_per_proc;
+        int k_rows = block_rows(block, rows_per_proc, size, n);
+        const double* B_block = current.data();
+        #pragma omp parallel for
+        for (int i = 0; i < local_rows; i++) {
+            double* c_row = &C_local[(size_t)i * n];
+            for (int k = 0; k < k_rows; k++) {
+                double a = A_local[(size_t)i * n + k0 + k];
+                const double* b_row = &B_block[(size_t)k * n];
+                for (int j = 0; j < n; j++) {
+                    c_row[j] += a * b_row[j];
+                }
+            }
+        }
+        
+        MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+        current.swap(incoming);
+        block = next_block;
+    }
+}
+
+// ===== Algorithm-Based Fault Tolerance (ABFT) =====
+//
+// A is conceptually augmented with a column-checksum row per tile row block
+// and B with a row-checksum column per tile column block. After the local
+// product, the checksums of every b x b tile of C are compared against the
+// values predicted from A and B. A single corrupted element shows up as one
+// bad row sum and one bad column sum, which locates and corrects it; any
+// other mismatch pattern triggers a local recompute of the tile. Verification
+// costs about 2/b of the multiply (~3% for b = 64).
+
+struct AbftOptions {
+    int tile;              // Tile edge length b
+    double tolerance;      // Relative checksum tolerance
+    bool inject_fault;     // Corrupt C before verification (testing only)
+    
+    AbftOptions() : tile(64), tolerance(1e-9), inject_fault(false) {}
+};
+
+struct AbftReport {
+    long tiles_checked;
+    long tiles_corrupted;
+    long elements_corrected;
+    long tiles_recomputed;
+};
+
+// Recompute C[i0:i1, j0:j1] from A and B
+static void abft_recompute_tile(const double* A, const double* B, double* C, int n,
+                                int i0, int i1, int j0, int j1) {
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += A[i * n + k] * B[k * n + j];
+            }
+            C[i * n + j] = sum;
+        }
+    }
+}
+
+static inline bool abft_mismatch(double expected, double actual, double tol) {
+    return fabs(expected - actual) > tol * fmax(1.0, fabs(expected));
+}
+
+// Verify the checksums of every tile in rows [start_row, end_row) of C,
+// correcting single-element errors and recomputing other corrupted tiles
+AbftReport abft_verify_rows(const double* A, const double* B, double* C, int n,
+                            int start_row, int end_row, const AbftOptions& opts) {
+    int b = opts.tile;
+    int col_tiles = (n + b - 1) / b;
+    int row_tiles = (end_row - start_row + b - 1) / b;
+    
+    // Row-checksum columns of B: B_sum[k][jt] = sum of B[k][j] over tile jt
+    vector<double> B_sum((size_t)n * col_tiles, 0.0);
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++) {
+        for (int j = 0; j < n; j++) {
+            B_sum[(size_t)k * col_tiles + j / b] += B[k * n + j];
+        }
+    }
+    
+    long corrupted = 0, corrected = 0, recomputed = 0;
+    
+    #pragma omp parallel for schedule(dynamic) reduction(+:corrupted,corrected,recomputed)
+    for (int it = 0; it < row_tiles; it++) {
+        int i0 = start_row + it * b;
+        int i1 = min(i0 + b, end_row);
+        int rows = i1 - i0;
+        
+        // Column-checksum row of A for this row block
+        vector<double> A_sum(n, 0.0);
+        for (int i = i0; i < i1; i++) {
+            for (int k = 0; k < n; k++) {
+                A_sum[k] += A[i * n + k];
+            }
+        }
+        
+        // Expected and actual column sums over the row block
+        vector<double> col_expected(n, 0.0), col_actual(n, 0.0);
+        for (int k = 0; k < n; k++) {
+            double a = A_sum[k];
+            for (int j = 0; j < n; j++) {
+                col_expected[j] += a * B[k * n + j];
+            }
+        }
+        for (int i = i0; i < i1; i++) {
+            for (int j = 0; j < n; j++) {
+                col_actual[j] += C[i * n + j];
+            }
+        }
+        
+        // Expected and actual row sums per column tile
+        vector<double> row_expected((size_t)rows * col_tiles, 0.0);
+        vector<double> row_actual((size_t)rows * col_tiles, 0.0);
+        for (int i = i0; i < i1; i++) {
+            double* re = &row_expected[(size_t)(i - i0) * col_tiles];
+            double* ra = &row_actual[(size_t)(i - i0) * col_tiles];
+            for (int k = 0; k < n; k++) {
+                double a = A[i * n + k];
+                const double* bs = &B_sum[(size_t)k * col_tiles];
+                for (int jt = 0; jt < col_tiles; jt++) {
+                    re[jt] += a * bs[jt];
+                }
+            }
+            for (int j = 0; j < n; j++) {
+                ra[j / b] += C[i * n + j];
+            }
+        }
+        
+        for (int jt = 0; jt < col_tiles; jt++) {
+            int j0 = jt * b;
+            int j1 = min(j0 + b, n);
+            
+            int bad_rows = 0, bad_cols = 0, bad_i = -1, bad_j = -1;
+            for (int i = i0; i < i1; i++) {
+                size_t idx = (size_t)(i - i0) * col_tiles + jt;
+                if (abft_mismatch(row_expected[idx], row_actual[idx], opts.tolerance)) {
+                    bad_rows++;
+                    bad_i = i;
+                }
+            }
+            for (int j = j0; j < j1; j++) {
+                if (abft_mismatch(col_expected[j], col_actual[j], opts.tolerance)) {
+                    bad_cols++;
+                    bad_j = j;
+                }
+            }
+            
+            if (bad_rows == 0 && bad_cols == 0) {
+                continue;
+            }
+            corrupted++;
+            
+            if (bad_rows == 1 && bad_cols == 1) {
+                // Single-element error: both residuals must agree
+                size_t idx = (size_t)(bad_i - i0) * col_tiles + jt;
+                double row_delta = row_expected[idx] - row_actual[idx];
+                double col_delta = col_expected[bad_j] - col_actual[bad_j];
+                if (!abft_mismatch(row_delta, col_delta, opts.tolerance)) {
+                    C[bad_i * n + bad_j] += row_delta;
+                    corrected++;
+                    continue;
+                }
+            }
+            
+            abft_recompute_tile(A, B, C, n, i0, i1, j0, j1);
+            recomputed++;
+        }
+    }
+    
+    AbftReport report;
+    report.tiles_checked = (long)row_tiles * col_tiles;
+    report.tiles_corrupted = corrupted;
+    report.elements_corrected = corrected;
+    report.tiles_recomputed = recomputed;
+    return report;
+}
+
+// Matrix multiplication with ABFT checksum verification
+// Returns the fault report summed over all ranks (valid on rank 0)
+AbftReport matrix_multiply_abft_mpi(double* A, double* B, double* C,
+                                    int rank, int size, int n,
+                                    const AbftOptions& opts,
+                                    OutputDistribution output = OUTPUT_ROOT) {
+    
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    #pragma omp parallel for collapse(2)
+    for (int i = start_row; i < end_row; i++) {
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += A[i * n + k] * B[k * n + j];
+            }
+            C[i * n + j] = sum;
+        }
+    }
+    
+    if (opts.inject_fault && end_row - start_row > 1 && n > opts.tile + 1) {
+        // One single-element error (correctable) in the first tile and a
+        // two-element error (needs recompute) in the next column tile
+        C[start_row * n] += 1000.0;
+        C[start_row * n + opts.tile] -= 50.0;
+        C[(start_row + 1) * n + opts.tile + 1] += 75.0;
+    }
+    
+    AbftReport local = abft_verify_rows(A, B, C, n, start_row, end_row, opts);
+    
+    long local_counts[4] = {local.tiles_checked, local.tiles_corrupted,
+                            local.elements_corrected, local.tiles_recomputed};
+    long total_counts[4] = {0, 0, 0, 0};
+    MPI_Reduce(local_counts, total_counts, 4, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    
+    collect_rows(C, output, rank, size, n);
+    
+    AbftReport report;
+    report.tiles_checked = total_counts[0];
+    report.tiles_corrupted = total_counts[1];
+    report.elements_corrected = total_counts[2];
+    report.tiles_recomputed = total_counts[3];
+    return report;
+}
+
+// Iterations between automatic compression decisions in the inverse
+const int INVERSE_COMPRESSION_WINDOW = 16;
+
+// Gauss-Jordan elimination for matrix inversion (distributed)
+// Every iteration needs the replicated matrices; the output distribution
+// only decides what the last iteration collects. Returns false if singular
+// (A_inv is then incomplete); the pivot search runs on the replicas, so
+// every rank returns the same answer.
+bool matrix_inverse_mpi(const double* A, double* A_inv, int rank, int size, int n,
+                        OutputDistribution output = OUTPUT_ALLGATHER) {
+    
+    // Copy A to working matrix
+    double* work = new double[n * n];
+    #pragma omp parallel for
+    for (int i = 0; i < n * n; i++) {
+        work[i] = A[i];
+    }
+    
+    initialize_identity(A_inv, n);
+    
+    // Distribute rows among processors
+    int rows_per_proc = n / size;
+    
+    for (int col = 0; col < n; col++) {
+        // Find pivot
+        int pivot_row = col;
+        double max_val = fabs(work[col * n + col]);
+        
+        for (int i = col + 1; i < n; i++) {
+            if (fabs(work[i * n + col]) > max_val) {
+                max_val = fabs(work[i * n + col]);
+                pivot_row = i;
+            }
+        }
+        
+        // Swap rows if needed
+        if (pivot_row != col) {
+            for (int j = 0; j < n; j++) {
+                swap(work[col * n + j], work[pivot_row * n + j]);
+                swap(A_inv[col * n + j], A_inv[pivot_row * n + j]);
+            }
+        }
+        
+        // Scale pivot row
+        double pivot = work[col * n + col];
+        if (fabs(pivot) < 1e-10) {
+            delete[] work;
+            return false;
+        }
+        
+        #pragma omp parallel for
+        for (int j = 0; j < n; j++) {
+            work[col * n + j] /= pivot;
+            A_inv[col * n + j] /= pivot;
+        }
+        
+        // Eliminate column (distributed among processes)
+        int start_row = rank * rows_per_proc;
+        int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+        double comp_start = MPI_Wtime();
+        
+        #pragma omp parallel for
+        for (int i = start_row; i < end_row; i++) {
+            if (i != col) {
+                double factor = work[i * n + col];
+                for (int j = 0; j < n; j++) {
+                    work[i * n + j] -= factor * work[col * n + j];
+                    A_inv[i * n + j] -= factor * A_inv[col * n + j];
+                }
+            }
+        }
+        
+        if (col == n - 1) {
+            collect_rows(A_inv, output, rank, size, n);
+            break;
+        }
+        
+        // Synchronize work and A_inv matrices. Every rank searches the
+        // pivot in its replica, so they must stay exact: lossy compression
+        // falls back to lossless here.
+        double comm_start = MPI_Wtime();
+        allgather_rows(work, rank, size, n, false);
+        allgather_rows(A_inv, rank, size, n, false);
+        compression_record(comm_start - comp_start, MPI_Wtime() - comm_start);
+        
+        // Revisit the auto-compression decision periodically
+        if ((col + 1) % INVERSE_COMPRESSION_WINDOW == 0) {
+            compression_decide();
+        }
+    }
+    
+    delete[] work;
+    return true;
+}
+
+// Gauss-Jordan inversion of the whole matrix on every rank, threads only.
+// No communication; wins when the allgathers of the distributed version
+// cost more than the redundant elimination. Returns false if singular.
+bool matrix_inverse_replicated(const double* A, double* A_inv, int n) {
+    vector<double> work(A, A + (size_t)n * n);
+    initialize_identity(A_inv, n);
+    
+    for (int col = 0; col < n; col++) {
+        int pivot_row = col;
+        double max_val = fabs(work[col * n + col]);
+        for (int i = col + 1; i < n; i++) {
+            if (fabs(work[i * n + col]) > max_val) {
+                max_val = fabs(work[i * n + col]);
+                pivot_row = i;
+            }
+        }
+        
+        if (pivot_row != col) {
+            for (int j = 0; j < n; j++) {
+                swap(work[col * n + j], work[pivot_row * n + j]);
+                swap(A_inv[col * n + j], A_inv[pivot_row * n + j]);
+            }
+        }
+        
+        double pivot = work[col * n + col];
+        if (fabs(pivot) < 1e-10) {
+            return false;
+        }
+        for (int j = 0; j < n; j++) {
+            work[col * n + j] /= pivot;
+            A_inv[col * n + j] /= pivot;
+        }
+        
+        #pragma omp parallel for
+        for (int i = 0; i < n; i++) {
+            if (i != col) {
+                double factor = work[i * n + col];
+                for (int j = 0; j < n; j++) {
+                    work[i * n + j] -= factor * work[col * n + j];
+                    A_inv[i * n + j] -= factor * A_inv[col * n + j];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// ===== LU / Cholesky factorization and determinant =====
+
+// Owner rank of a global row under the row-striped distribution (the last
+// rank takes the remainder, so with fewer rows than ranks it owns them all)
+static inline int row_owner(int row, int rows_per_proc, int size) {
+    if (rows_per_proc == 0) return size - 1;
+    int owner = row / rows_per_proc;
+    return (owner >= size) ? size - 1 : owner;
+}
+
+// LU factorization with partial pivoting (distributed, row-striped)
+// Each rank factors its own rows of A into LU (L below the diagonal with unit
+// diagonal implied, U on and above). pivots[k] is the global row exchanged
+// with row k at step k and is identical on every rank.
+// Returns false if a zero pivot column was found (A is singular).
+bool lu_factor_mpi(const double* A, double* LU, int* pivots,
+                   int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    #pragma omp parallel for
+    for (int i = start_row * n; i < end_row * n; i++) {
+        LU[i] = A[i];
+    }
+    
+    bool nonsingular = true;
+    vector<double> pivot_row(n);
+    
+    for (int k = 0; k < n; k++) {
+        // Global pivot search: largest |LU[i][k]| over rows i >= k
+        struct { double val; int row; } local_max, global_max;
+        local_max.val = -1.0;
+        local_max.row = k;
+        for (int i = max(k, start_row); i < end_row; i++) {
+            double v = fabs(LU[i * n + k]);
+            if (v > local_max.val) {
+                local_max.val = v;
+                local_max.row = i;
+            }
+        }
+        MPI_Allreduce(&local_max, &global_max, 1, MPI_DOUBLE_INT, MPI_MAXLOC,
+                      MPI_COMM_WORLD);
+        
+        int p = global_max.row;
+        pivots[k] = p;
+        
+        // Exchange rows k and p between their owners
+        if (p != k) {
+            int owner_k = row_owner(k, rows_per_proc, size);
+            int owner_p = row_owner(p, rows_per_proc, size);
+            if (owner_k == owner_p) {
+                if (rank == owner_k) {
+                    for (int j = 0; j < n; j++) {
+                        swap(LU[k * n + j], LU[p * n + j]);
+                    }
+                }
+            } else if (rank == owner_k) {
+                MPI_Sendrecv_replace(&LU[k * n], n, MPI_DOUBLE, owner_p, k,
+                                     owner_p, k, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            } else if (rank == owner_p) {
+                MPI_Sendrecv_replace(&LU[p * n], n, MPI_DOUBLE, owner_k, k,
+                                     owner_k, k, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            }
+        }
+        
+        if (global_max.val == 0.0) {
+            nonsingular = false;
+            continue;
+        }
+        
+        // Broadcast the pivot row (columns k..n-1)
+        int owner_k = row_owner(k, rows_per_proc, size);
+        if (rank == owner_k) {
+            for (int j = k; j < n; j++) {
+                pivot_row[j] = LU[k * n + j];
+            }
+        }
+        hier_bcast(&pivot_row[k], n - k, MPI_DOUBLE, owner_k);
+        
+        // Eliminate below the pivot in the owned rows
+        double pivot = pivot_row[k];
+        int first = max(k + 1, start_row);
+        #pragma omp parallel for
+        for (int i = first; i < end_row; i++) {
+            double l = LU[i * n + k] / pivot;
+            LU[i * n + k] = l;
+            for (int j = k + 1; j < n; j++) {
+                LU[i * n + j] -= l * pivot_row[j];
+            }
+        }
+    }
+    
+    return nonsingular;
+}
+
+// Cholesky factorization A = L * L^T for symmetric positive definite A
+// (distributed, row-striped). The owned rows of L hold the factor in their
+// lower triangle. Returns false if A is not positive definite.
+bool cholesky_factor_mpi(const double* A, double* L, int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    #pragma omp parallel for
+    for (int i = start_row * n; i < end_row * n; i++) {
+        L[i] = A[i];
+    }
+    
+    vector<double> col(n);
+    
+    for (int k = 0; k < n; k++) {
+        // Row k of the trailing matrix equals column k by symmetry
+        int owner_k = row_owner(k, rows_per_proc, size);
+        if (rank == owner_k) {
+            for (int j = k; j < n; j++) {
+                col[j] = L[k * n + j];
+            }
+        }
+        hier_bcast(&col[k], n - k, MPI_DOUBLE, owner_k);
+        
+        if (col[k] <= 0.0) {
+            return false;
+        }
+        
+        double diag = sqrt(col[k]);
+        for (int j = k + 1; j < n; j++) {
+            col[j] /= diag;
+        }
+        
+        if (rank == owner_k) {
+            L[k * n + k] = diag;
+            for (int j = k + 1; j < n; j++) {
+                L[k * n + j] = 0.0;
+            }
+        }
+        
+        // Trailing update of the owned rows (full rows keep the symmetry)
+        int first = max(k + 1, start_row);
+        #pragma omp parallel for
+        for (int i = first; i < end_row; i++) {
+            double l = col[i];
+            L[i * n + k] = l;
+            for (int j = k + 1; j < n; j++) {
+                L[i * n + j] -= l * col[j];
+            }
+        }
+    }
+    
+    return true;
+}
+
+struct LogDeterminant {
+    double sign;        // -1, 0 or +1
+    double log_abs;     // log|det(A)|, -inf when singular
+};
+
+// Sign and log|det(A)| from the distributed LU (or Cholesky when spd is set
+// and A is positive definite). Summing logs of the diagonal avoids the
+// overflow of the plain product for large n. The diagonal log-sums, the sign
+// flips and the zero-pivot count are reduced in a single allreduce.
+LogDeterminant log_determinant_mpi(const double* A, int rank, int size, int n,
+                                   bool spd = false) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    double* factor = new double[(size_t)n * n];
+    
+    // local[0]: sum of log|d_ii|, local[1]: sign flips, local[2]: zero pivots
+    double local[3] = {0.0, 0.0, 0.0};
+    
+    if (spd && cholesky_factor_mpi(A, factor, rank, size, n)) {
+        for (int i = start_row; i < end_row; i++) {
+            local[0] += 2.0 * log(factor[i * n + i]);
+        }
+    } else {
+        int* pivots = new int[n];
+        lu_factor_mpi(A, factor, pivots, rank, size, n);
+        
+        for (int i = start_row; i < end_row; i++) {
+            double d = factor[i * n + i];
+            if (d == 0.0) {
+                local[2] += 1.0;
+            } else {
+                local[0] += log(fabs(d));
+                if (d < 0.0) local[1] += 1.0;
+            }
+        }
+        
+        // Pivot parity (the pivot sequence is replicated, count it once)
+        if (rank == 0) {
+            for (int k = 0; k < n; k++) {
+                if (pivots[k] != k) local[1] += 1.0;
+            }
+        }
+        delete[] pivots;
+    }
+    
+    double global[3];
+    MPI_Allreduce(local, global, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    
+    delete[] factor;
+    
+    LogDeterminant result;
+    if (global[2] > 0.0) {
+        result.sign = 0.0;
+        result.log_abs = -INFINITY;
+    } else {
+        result.sign = (((long)global[1]) % 2 == 0) ? 1.0 : -1.0;
+        result.log_abs = global[0];
+    }
+    return result;
+}
+
+// Determinant from the log-determinant (overflows to +/-inf for large n,
+// keep the log form when the magnitude may exceed double range)
+double determinant(const LogDeterminant& ld) {
+    return ld.sign * exp(ld.log_abs);
+}
+
+// ===== Implicit Kronecker-product operations =====
+//
+// (A kron B) * vec(X) = vec(B * X * A^T) with column-major vec. A column-major
+// s x q matrix X is stored exactly like the row-major q x s matrix X^T, so with
+// the row-major buffers used here each vector is handled as X^T and the
+// result is Y^T = A * X^T * B^T. The Kronecker product is never formed.
+
+// Rectangular C (m x n) = A (m x k) * B (k x n), row-striped over m, with the
+// result allgathered so every rank holds the full C
+void matrix_multiply_rect_mpi(const double* A, const double* B, double* C,
+                              int m, int k, int n, int rank, int size) {
+    int rows_per_proc = m / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? m : start_row + rows_per_proc;
+    
+    #pragma omp parallel for
+    for (int i = start_row; i < end_row; i++) {
+        double* c = &C[(size_t)i * n];
+        for (int j = 0; j < n; j++) {
+            c[j] = 0.0;
+        }
+        for (int l = 0; l < k; l++) {
+            double a = A[(size_t)i * k + l];
+            const double* b = &B[(size_t)l * n];
+            for (int j = 0; j < n; j++) {
+                c[j] += a * b[j];
+            }
+        }
+    }
+    
+    vector<int> counts(size), displs(size);
+    for (int p = 0; p < size; p++) {
+        int p_start = p * rows_per_proc;
+        int p_end = (p == size - 1) ? m : p_start + rows_per_proc;
+        counts[p] = (p_end - p_start) * n;
+        displs[p] = p_start * n;
+    }
+    hier_allgatherv(C, counts.data(), displs.data());
+}
+
+// Y = (A kron B) * X for num_vecs vectors stored back to back
+// A is p x q, B is r x s; each X vector has length q*s, each Y vector p*r.
+// Runs as two distributed GEMMs: the stacked X^T blocks times B^T, then A
+// times the side-by-side result.
+void kron_matmat_mpi(const double* A, int p, int q,
+                     const double* B, int r, int s,
+                     const double* X, double* Y, int num_vecs,
+                     int rank, int size) {
+    int t = num_vecs;
+    
+    vector<double> B_t((size_t)s * r);
+    for (int i = 0; i < r; i++) {
+        for (int j = 0; j < s; j++) {
+            B_t[(size_t)j * r + i] = B[(size_t)i * s + j];
+        }
+    }
+    
+    // U = [X_1^T; ...; X_t^T] * B^T   ((q*t) x r)
+    vector<double> U((size_t)q * t * r);
+    matrix_multiply_rect_mpi(X, B_t.data(), U.data(), q * t, s, r, rank, size);
+    
+    // W = [U_1 | ... | U_t]   (q x (r*t))
+    vector<double> W((size_t)q * r * t);
+    #pragma omp parallel for
+    for (int i = 0; i < q; i++) {
+        for (int c = 0; c < t; c++) {
+            const double* src = &U[((size_t)c * q + i) * r];
+            double* dst = &W[(size_t)i * r * t + (size_t)c * r];
+            for (int j = 0; j < r; j++) {
+                dst[j] = src[j];
+            }
+        }
+    }
+    
+    // Z = A * W   (p x (r*t)), then unstack into Y_c^T = Z[:, c*r:(c+1)*r]
+    vector<double> Z((size_t)p * r * t);
+    matrix_multiply_rect_mpi(A, W.data(), Z.data(), p, q, r * t, rank, size);
+    
+    #pragma omp parallel for
+    for (int i = 0; i < p; i++) {
+        for (int c = 0; c < t; c++) {
+            const double* src = &Z[(size_t)i * r * t + (size_t)c * r];
+            double* dst = &Y[(size_t)c * p * r + (size_t)i * r];
+            for (int j = 0; j < r; j++) {
+                dst[j] = src[j];
+            }
+        }
+    }
+}
+
+// y = (A kron B) * x for a single vector
+void kron_matvec_mpi(const double* A, int p, int q,
+                     const double* B, int r, int s,
+                     const double* x, double* y, int rank, int size) {
+    kron_matmat_mpi(A, p, q, B, r, s, x, y, 1, rank, size);
+}
+
+// Solve (A kron B) * X = Y for num_vecs right-hand sides, with A m x m and
+// B n x n, using (A kron B)^-1 = A^-1 kron B^-1 on the factor inverses.
+// Returns false (X untouched) if either factor is singular.
+bool kron_solve_mpi(const double* A, int m, const double* B, int n,
+                    const double* Y, double* X, int num_vecs,
+                    int rank, int size) {
+    vector<double> A_inv((size_t)m * m), B_inv((size_t)n * n);
+    if (!matrix_inverse_mpi(A, A_inv.data(), rank, size, m) ||
+        !matrix_inverse_mpi(B, B_inv.data(), rank, size, n)) {
+        return false;
+    }
+    kron_matmat_mpi(A_inv.data(), m, m, B_inv.data(), n, n, Y, X, num_vecs, rank, size);
+    return true;
+}
+
+// ===== Batched small-matrix GEMM =====
+//
+// Many independent n x n products (n = 4..64). The row-striped decomposition
+// of matrix_multiply_mpi is useless at these sizes, so whole batch entries
+// are distributed: a contiguous range per rank, entries within it across
+// OpenMP threads. Common sizes use kernels with the size fixed at compile
+// time; 4 x 4 and 8 x 8 additionally interleave BATCH_SIMD_WIDTH entries so
+// each unrolled scalar operation becomes one SIMD operation across entries.
+
+const int BATCH_SIMD_WIDTH = 8;
+
+// Compile-time loop: calls f(I), f(I+1), ..., f(N-1), fully unrolled
+template <int I, int N>
+struct Unroll {
+    template <typename F>
+    static inline void run(F& f) {
+        f(I);
+        Unroll<I + 1, N>::run(f);
+    }
+};
+
+template <int N>
+struct Unroll<N, N> {
+    template <typename F>
+    static inline void run(F&) {}
+};
+
+// Batch accessors: entry i of a strided batch or a pointer-array batch
+struct StridedBatch {
+    const double* base;
+    long stride;
+    StridedBatch(const double* b, long s) : base(b), stride(s) {}
+    const double* operator()(long i) const { return base + i * stride; }
+};
+
+struct PointerBatch {
+    const double* const* ptrs;
+    explicit PointerBatch(const double* const* p) : ptrs(p) {}
+    const double* operator()(long i) const { return ptrs[i]; }
+};
+
+struct MutableStridedBatch {
+    double* base;
+    long stride;
+    MutableStridedBatch(double* b, long s) : base(b), stride(s) {}
+    double* operator()(long i) const { return base + i * stride; }
+};
+
+struct MutablePointerBatch {
+    double* const* ptrs;
+    explicit MutablePointerBatch(double* const* p) : ptrs(p) {}
+    double* operator()(long i) const { return ptrs[i]; }
+};
+
+// C = A * B for one N x N entry, N known at compile time
+template <int N>
+static inline void gemm_fixed(const double* A, const double* B, double* C) {
+    for (int i = 0; i < N; i++) {
+        double c[N];
+        #pragma omp simd
+        for (int j = 0; j < N; j++) {
+            c[j] = 0.0;
+        }
+        for (int k = 0; k < N; k++) {
+            double a = A[i * N + k];
+            const double* b = &B[k * N];
+            #pragma omp simd
+            for (int j = 0; j < N; j++) {
+                c[j] += a * b[j];
+            }
+        }
+        for (int j = 0; j < N; j++) {
+            C[i * N + j] = c[j];
+        }
+    }
+}
+
+// Accumulates one C element of W interleaved entries, unrolled over k
+template <int N, int W>
+struct InterleavedDot {
+    const double* A;
+    const double* B;
+    double* acc;
+    int i, j;
+    inline void operator()(int k) {
+        const double* a = &A[(i * N + k) * W];
+        const double* b = &B[(k * N + j) * W];
+        #pragma omp simd
+        for (int w = 0; w < W; w++) {
+            acc[w] += a[w] * b[w];
+        }
+    }
+};
+
+// C = A * B for W entries stored interleaved ([N*N][W])
+template <int N, int W>
+static inline void gemm_fixed_interleaved(const double* A, const double* B, double* C) {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            double acc[W];
+            #pragma omp simd
+            for (int w = 0; w < W; w++) {
+                acc[w] = 0.0;
+            }
+            InterleavedDot<N, W> dot = {A, B, acc, i, j};
+            Unroll<0, N>::run(dot);
+            #pragma omp simd
+            for (int w = 0; w < W; w++) {
+                C[(i * N + j) * W + w] = acc[w];
+            }
+        }
+    }
+}
+
+static inline void gemm_generic(const double* A, const double* B, double* C, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            C[i * n + j] = 0.0;
+        }
+        for (int k = 0; k < n; k++) {
+            double a = A[i * n + k];
+            #pragma omp simd
+            for (int j = 0; j < n; j++) {
+                C[i * n + j] += a * B[k * n + j];
+            }
+        }
+    }
+}
+
+template <int N, class BA, class BB, class BC>
+static void batched_gemm_fixed(BA A, BB B, BC C, long begin, long end) {
+    #pragma omp parallel for schedule(static)
+    for (long e = begin; e < end; e++) {
+        gemm_fixed<N>(A(e), B(e), C(e));
+    }
+}
+
+template <int N, class BA, class BB, class BC>
+static void batched_gemm_simd(BA A, BB B, BC C, long begin, long end) {
+    const int W = BATCH_SIMD_WIDTH;
+    long groups = (end - begin) / W;
+    
+    #pragma omp parallel
+    {
+        double a_il[N * N * W], b_il[N * N * W], c_il[N * N * W];
+        
+        #pragma omp for schedule(static)
+        for (long g = 0; g < groups; g++) {
+            long e0 = begin + g * W;
+            for (int w = 0; w < W; w++) {
+                const double* a = A(e0 + w);
+                const double* b = B(e0 + w);
+                for (int x = 0; x < N * N; x++) {
+                    a_il[x * W + w] = a[x];
+                    b_il[x * W + w] = b[x];
+                }
+            }
+            gemm_fixed_interleaved<N, W>(a_il, b_il, c_il);
+            for (int w = 0; w < W; w++) {
+                double* c = C(e0 + w);
+                for (int x = 0; x < N * N; x++) {
+                    c[x] = c_il[x * W + w];
+                }
+            }
+        }
+    }
+    
+    for (long e = begin + groups * W; e < end; e++) {
+        gemm_fixed<N>(A(e), B(e), C(e));
+    }
+}
+
+template <class BA, class BB, class BC>
+static void batched_gemm_range(BA A, BB B, BC C, int n, long begin, long end) {
+    switch (n) {
+        case 4:  batched_gemm_simd<4>(A, B, C, begin, end); break;
+        case 8:  batched_gemm_simd<8>(A, B, C, begin, end); break;
+        case 16: batched_gemm_fixed<16>(A, B, C, begin, end); break;
+        case 32: batched_gemm_fixed<32>(A, B, C, begin, end); break;
+        case 64: batched_gemm_fixed<64>(A, B, C, begin, end); break;
+        default:
+            #pragma omp parallel for schedule(static)
+            for (long e = begin; e < end; e++) {
+                gemm_generic(A(e), B(e), C(e), n);
+            }
+    }
+}
+
+// Batch range [begin, end) computed by a rank
+static inline void batch_range(long batch_count, int rank, int size,
+                               long* begin, long* end) {
+    long per_proc = batch_count / size;
+    *begin = rank * per_proc;
+    *end = (rank == size - 1) ? batch_count : *begin + per_proc;
+}
+
+// Strided batch: entry e of A is A + e * stride_a (likewise B and C).
+// Every rank computes its range; the results are gathered into C on rank 0.
+void batched_gemm_strided_mpi(const double* A, long stride_a,
+                              const double* B, long stride_b,
+                              double* C, long stride_c,
+                              int n, long batch_count, int rank, int size) {
+    long begin, end;
+    batch_range(batch_count, rank, size, &begin, &end);
+    
+    batched_gemm_range(StridedBatch(A, stride_a), StridedBatch(B, stride_b),
+                       MutableStridedBatch(C, stride_c), n, begin, end);
+    
+    // One n x n entry with the extent of the C stride
+    MPI_Datatype entry_strided = strided_entry_datatype(n * n, stride_c);
+    
+    vector<int> counts(size), displs(size);
+    for (int p = 0; p < size; p++) {
+        long p_begin, p_end;
+        batch_range(batch_count, p, size, &p_begin, &p_end);
+        counts[p] = (int)(p_end - p_begin);
+        displs[p] = (int)p_begin;
+    }
+    
+    if (rank == 0) {
+        MPI_Gatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
+                    C, counts.data(), displs.data(), entry_strided, 0, MPI_COMM_WORLD);
+    } else {
+        MPI_Gatherv(C + begin * stride_c, counts[rank], entry_strided,
+                    NULL, NULL, NULL, entry_strided, 0, MPI_COMM_WORLD);
+    }
+}
+
+// Pointer-array batch: entry e is A[e], B[e], C[e]. Every rank computes its
+// range; rank 0 receives the results directly into its C[e] buffers through
+// an hindexed datatype built from the absolute addresses.
+void batched_gemm_pointers_mpi(const double* const* A, const double* const* B,
+                               double* const* C, int n, long batch_count,
+                               int rank, int size) {
+    long begin, end;
+    batch_range(batch_count, rank, size, &begin, &end);
+    
+    batched_gemm_range(PointerBatch(A), PointerBatch(B), MutablePointerBatch(C),
+                       n, begin, end);
+    
+    if (rank == 0) {
+        for (int p = 1; p < size; p++) {
+            long p_begin, p_end;
+            batch_range(batch_count, p, size, &p_begin, &p_end);
+            int count = (int)(p_end - p_begin);
+            if (count == 0) continue;
+            
+            vector<int> lengths(count, n * n);
+            vector<MPI_Aint> addrs(count);
+            for (int e = 0; e < count; e++) {
+                MPI_Get_address(C[p_begin + e], &addrs[e]);
+            }
+            MPI_Datatype recv_type;
+            MPI_Type_create_hindexed(count, lengths.data(), addrs.data(), MPI_DOUBLE, &recv_type);
+            MPI_Type_commit(&recv_type);
+            MPI_Recv(MPI_BOTTOM, 1, recv_type, p, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Type_free(&recv_type);
+        }
+    } else if (end > begin) {
+        int count = (int)(end - begin);
+        vector<int> lengths(count, n * n);
+        vector<MPI_Aint> addrs(count);
+        for (int e = 0; e < count; e++) {
+            MPI_Get_address(C[begin + e], &addrs[e]);
+        }
+        MPI_Datatype send_type;
+        MPI_Type_create_hindexed(count, lengths.data(), addrs.data(), MPI_DOUBLE, &send_type);
+        MPI_Type_commit(&send_type);
+        MPI_Send(MPI_BOTTOM, 1, send_type, 0, 0, MPI_COMM_WORLD);
+        MPI_Type_free(&send_type);
+    }
+}
+
+// ===== Integer and low-precision GEMM =====
+//
+// int8 x int8 and int16 x int16 with int32 accumulation, and bf16 / fp16
+// inputs with float accumulation, using the same row-striped decomposition
+// and gather as matrix_multiply_mpi. Kernels use AVX512-VNNI (vpdpwssd) and
+// AVX512-BF16 (vdpbf16ps) when the CPU reports them at run time and fall
+// back to portable emulation otherwise. Both SIMD paths consume pairs along
+// k, so B is repacked once into [k/2][n][2] with a zero row when n is odd.
+
+typedef uint16_t bf16_t;
+typedef uint16_t fp16_t;
+
+// Round-to-nearest-even float -> bf16
+static inline bf16_t float_to_bf16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return (bf16_t)((bits >> 16) | 0x40);   // quiet NaN
+    }
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return (bf16_t)(bits >> 16);
+}
+
+static inline float bf16_to_float(bf16_t h) {
+    uint32_t bits = (uint32_t)h << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round-to-nearest-even float -> IEEE half (overflows to inf, keeps subnormals)
+static inline fp16_t float_to_fp16(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs = bits & 0x7fffffffu;
+    if (abs > 0x7f800000u) return (fp16_t)(sign | 0x7e00u);     // quiet NaN
+    if (abs >= 0x477ff000u) return (fp16_t)(sign | 0x7c00u);    // rounds past 65504
+    if (abs < 0x38800000u) {
+        // Subnormal half: mantissa (with the implicit bit) shifted into 2^-24 units
+        if (abs < 0x33000000u) return (fp16_t)sign;
+        uint32_t shift = 126 - (abs >> 23);
+        uint32_t mant = (abs & 0x7fffffu) | 0x800000u;
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1u))) h++;
+        return (fp16_t)(sign | h);
+    }
+    uint32_t h = (abs - 0x38000000u) >> 13;                     // Rebias exponent 127 -> 15
+    uint32_t rem = abs & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) h++;     // May carry into the exponent
+    return (fp16_t)(sign | h);
+}
+
+// IEEE half -> float (handles subnormals, inf and NaN)
+static inline float fp16_to_float(fp16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+    uint32_t bits;
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            exp = 127 - 15 + 1;
+            while ((mant & 0x400u) == 0) {
+                mant <<= 1;
+                exp--;
+            }
+            bits = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+        }
+    } else if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Symmetric linear quantization: dst = round(src / scale), returns scale
+template <typename T>
+double quantize_symmetric(const double* src, T* dst, long count, int max_level) {
+    double max_abs = 0.0;
+    #pragma omp parallel for reduction(max:max_abs)
+    for (long i = 0; i < count; i++) {
+        max_abs = fmax(max_abs, fabs(src[i]));
+    }
+    double scale = (max_abs > 0.0) ? max_abs / max_level : 1.0;
+    #pragma omp parallel for
+    for (long i = 0; i < count; i++) {
+        dst[i] = (T)lrint(src[i] / scale);
+    }
+    return scale;
+}
+
+double quantize_int8(const double* src, int8_t* dst, long count) {
+    return quantize_symmetric(src, dst, count, 127);
+}
+
+double quantize_int16(const double* src, int16_t* dst, long count) {
+    return quantize_symmetric(src, dst, count, 32767);
+}
+
+static inline bool cpu_has_avx512_vnni() {
+#ifdef HAVE_X86_DISPATCH
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni");
+#else
+    return false;
+#endif
+}
+
+static inline bool cpu_has_avx512_bf16() {
+#ifdef HAVE_X86_DISPATCH
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16");
+#else
+    return false;
+#endif
+}
+
+// Repack B (n x n) into k-pairs: P[(k/2) * n * 2 + j * 2 + (k % 2)]
+template <typename S, typename T>
+static void pack_k_pairs(const S* B, T* P, int n) {
+    int kp = (n + 1) / 2;
+    #pragma omp parallel for
+    for (int p = 0; p < kp; p++) {
+        for (int j = 0; j < n; j++) {
+            int k = 2 * p;
+            P[((size_t)p * n + j) * 2] = (T)B[(size_t)k * n + j];
+            P[((size_t)p * n + j) * 2 + 1] = (k + 1 < n) ? (T)B[(size_t)(k + 1) * n + j] : (T)0;
+        }
+    }
+}
+
+#ifdef HAVE_X86_DISPATCH
+// C rows [start_row, end_row) with vpdpwssd on int16 k-pairs
+// (A_rows holds only rows start_row..end_row-1)
+__attribute__((target("avx512f,avx512vnni")))
+static void gemm_rows_int16_vnni(const int16_t* A_rows, const int16_t* B_pairs, int32_t* C,
+                                 int n, int start_row, int end_row) {
+    int kp = (n + 1) / 2;
+    #pragma omp parallel for
+    for (int i = start_row; i < end_row; i++) {
+        const int16_t* a = &A_rows[(size_t)(i - start_row) * n];
+        int j = 0;
+        for (; j + 16 <= n; j += 16) {
+            __m512i acc = _mm512_setzero_si512();
+            for (int p = 0; p < kp; p++) {
+                int16_t a1 = (2 * p + 1 < n) ? a[2 * p + 1] : 0;
+                uint32_t pair = (uint16_t)a[2 * p] | ((uint32_t)(uint16_t)a1 << 16);
+                __m512i av = _mm512_set1_epi32((int)pair);
+                __m512i bv = _mm512_loadu_si512(&B_pairs[((size_t)p * n + j) * 2]);
+                acc = _mm512_dpwssd_epi32(acc, av, bv);
+            }
+            _mm512_storeu_si512(&C[(size_t)i * n + j], acc);
+        }
+        for (; j < n; j++) {
+            int32_t sum = 0;
+            for (int k = 0; k < n; k++) {
+                sum += (int32_t)a[k] * B_pairs[((size_t)(k / 2) * n + j) * 2 + (k % 2)];
+            }
+            C[(size_t)i * n + j] = sum;
+        }
+    }
+}
+
+// C rows [start_row, end_row) with vdpbf16ps on bf16 k-pairs
+__attribute__((target("avx512f,avx512bf16")))
+static void gemm_rows_bf16_avx512(const bf16_t* A, const bf16_t* B_pairs, float* C,
+                                  int n, int start_row, int end_row) {
+    int kp = (n + 1) / 2;
+    #pragma omp parallel for
+    for (int i = start_row; i < end_row; i++) {
+        const bf16_t* a = &A[(size_t)i * n];
+        int j = 0;
+        for (; j + 16 <= n; j += 16) {
+            __m512 acc = _mm512_setzero_ps();
+            for (int p = 0; p < kp; p++) {
+                bf16_t a1 = (2 * p + 1 < n) ? a[2 * p + 1] : 0;
+                uint32_t pair = a[2 * p] | ((uint32_t)a1 << 16);
+                __m512bh av = (__m512bh)_mm512_set1_epi32((int)pair);
+                __m512bh bv = (__m512bh)_mm512_loadu_si512(&B_pairs[((size_t)p * n + j) * 2]);
+                acc = _mm512_dpbf16_ps(acc, av, bv);
+            }
+            _mm512_storeu_ps(&C[(size_t)i * n + j], acc);
+        }
+        for (; j < n; j++) {
+            float sum = 0.0f;
+            for (int k = 0; k < n; k++) {
+                sum += bf16_to_float(a[k]) *
+                       bf16_to_float(B_pairs[((size_t)(k / 2) * n + j) * 2 + (k % 2)]);
+            }
+            C[(size_t)i * n + j] = sum;
+        }
+    }
+}
+#endif
+
+// Portable integer kernel: C rows [start_row, end_row) with int32 accumulation
+template <typename T>
+static void gemm_rows_int_emulated(const T* A, const T* B, int32_t* C,
+                                   int n, int start_row, int end_row) {
+    #pragma omp parallel for
+    for (int i = start_row; i < end_row; i++) {
+        int32_t* c = &C[(size_t)i * n];
+        for (int j = 0; j < n; j++) {
+            c[j] = 0;
+        }
+        for (int k = 0; k < n; k++) {
+            int32_t a = A[(size_t)i * n + k];
+            const T* b = &B[(size_t)k * n];
+            #pragma omp simd
+            for (int j = 0; j < n; j++) {
+                c[j] += a * (int32_t)b[j];
+            }
+        }
+    }
+}
+
+// Portable float kernel on pre-converted rows of A and all of B
+static void gemm_rows_float(const float* A, const float* B, float* C,
+                            int n, int start_row, int end_row) {
+    #pragma omp parallel for
+    for (int i = start_row; i < end_row; i++) {
+        float* c = &C[(size_t)i * n];
+        for (int j = 0; j < n; j++) {
+            c[j] = 0.0f;
+        }
+        for (int k = 0; k < n; k++) {
+            float a = A[(size_t)(i - start_row) * n + k];
+            const float* b = &B[(size_t)k * n];
+            #pragma omp simd
+            for (int j = 0; j < n; j++) {
+                c[j] += a * b[j];
+            }
+        }
+    }
+}
+
+template <typename T>
+static void matrix_multiply_int_mpi(const T* A, const T* B, int32_t* C,
+                                    int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+#ifdef HAVE_X86_DISPATCH
+    if (cpu_has_avx512_vnni()) {
+        // Products of int8 or int16 values are exact in vpdpwssd
+        vector<int16_t> A_rows((size_t)(end_row - start_row) * n);
+        vector<int16_t> B_pairs((size_t)((n + 1) / 2) * n * 2);
+        for (size_t x = 0; x < A_rows.size(); x++) {
+            A_rows[x] = A[(size_t)start_row * n + x];
+        }
+        pack_k_pairs(B, B_pairs.data(), n);
+        gemm_rows_int16_vnni(A_rows.data(), B_pairs.data(), C, n, start_row, end_row);
+    } else
+#endif
+    {
+        gemm_rows_int_emulated(A, B, C, n, start_row, end_row);
+    }
+    
+    gather_rows_to_root(C, MPI_INT32_T, rank, size, n);
+}
+
+// int8 x int8 -> int32 multiplication (MPI + OpenMP)
+void matrix_multiply_int8_mpi(const int8_t* A, const int8_t* B, int32_t* C,
+                              int rank, int size, int n) {
+    matrix_multiply_int_mpi(A, B, C, rank, size, n);
+}
+
+// int16 x int16 -> int32 multiplication (MPI + OpenMP)
+// Sums must stay within int32: n * 32767^2 overflows for n > 2
+// full-scale, so callers quantize with enough headroom.
+void matrix_multiply_int16_mpi(const int16_t* A, const int16_t* B, int32_t* C,
+                               int rank, int size, int n) {
+    matrix_multiply_int_mpi(A, B, C, rank, size, n);
+}
+
+// bf16 x bf16 -> float multiplication (MPI + OpenMP)
+void matrix_multiply_bf16_mpi(const bf16_t* A, const bf16_t* B, float* C,
+                              int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+#ifdef HAVE_X86_DISPATCH
+    if (cpu_has_avx512_bf16()) {
+        vector<bf16_t> B_pairs((size_t)((n + 1) / 2) * n * 2);
+        pack_k_pairs(B, B_pairs.data(), n);
+        gemm_rows_bf16_avx512(A, B_pairs.data(), C, n, start_row, end_row);
+    } else
+#endif
+    {
+        vector<float> A_rows((size_t)(end_row - start_row) * n), B_f((size_t)n * n);
+        #pragma omp parallel for
+        for (long x = 0; x < (long)n * n; x++) {
+            B_f[x] = bf16_to_float(B[x]);
+        }
+        for (size_t x = 0; x < A_rows.size(); x++) {
+            A_rows[x] = bf16_to_float(A[(size_t)start_row * n + x]);
+        }
+        gemm_rows_float(A_rows.data(), B_f.data(), C, n, start_row, end_row);
+    }
+    
+    gather_rows_to_root(C, MPI_FLOAT, rank, size, n);
+}
+
+// fp16 x fp16 -> float multiplication (MPI + OpenMP, emulated)
+void matrix_multiply_fp16_mpi(const fp16_t* A, const fp16_t* B, float* C,
+                              int rank, int size, int n) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    vector<float> A_rows((size_t)(end_row - start_row) * n), B_f((size_t)n * n);
+    #pragma omp parallel for
+    for (long x = 0; x < (long)n * n; x++) {
+        B_f[x] = fp16_to_float(B[x]);
+    }
+    for (size_t x = 0; x < A_rows.size(); x++) {
+        A_rows[x] = fp16_to_float(A[(size_t)start_row * n + x]);
+    }
+    gemm_rows_float(A_rows.data(), B_f.data(), C, n, start_row, end_row);
+    
+    gather_rows_to_root(C, MPI_FLOAT, rank, size, n);
+}
+
+// --lowp=<type>: multiply the run's A and B again at reduced precision
+enum LowPrecision { LOWP_NONE, LOWP_INT8, LOWP_INT16, LOWP_BF16, LOWP_FP16 };
+
+bool parse_low_precision(const string& name, LowPrecision& precision) {
+    if (name == "int8") precision = LOWP_INT8;
+    else if (name == "int16") precision = LOWP_INT16;
+    else if (name == "bf16") precision = LOWP_BF16;
+    else if (name == "fp16") precision = LOWP_FP16;
+    else return false;
+    return true;
+}
+
+const char* low_precision_name(LowPrecision precision) {
+    switch (precision) {
+        case LOWP_INT8: return "int8";
+        case LOWP_INT16: return "int16";
+        case LOWP_BF16: return "bf16";
+        case LOWP_FP16: return "fp16";
+        default: return "double";
+    }
+}
+
+// Convert A and B, run the matching GEMM and return (on rank 0) the relative
+// Frobenius error of rank 0's rows against C_ref, the double-precision
+// product; other ranks return 0. Integer types are quantized with enough
+// headroom that n products of full-scale values still fit in int32.
+double matrix_multiply_low_precision_mpi(const double* A, const double* B, const double* C_ref,
+                                         LowPrecision precision, int rank, int size, int n) {
+    size_t count = (size_t)n * n;
+    vector<double> C(count);
+    
+    if (precision == LOWP_INT8 || precision == LOWP_INT16) {
+        int max_level = (precision == LOWP_INT8) ? 127 : 32767;
+        max_level = min(max_level, (int)sqrt((double)INT32_MAX / n));
+        vector<int32_t> C_int(count);
+        double scale;
+        if (precision == LOWP_INT8) {
+            vector<int8_t> A_q(count), B_q(count);
+            scale = quantize_symmetric(A, A_q.data(), (long)count, max_level) *
+                    quantize_symmetric(B, B_q.data(), (long)count, max_level);
+            matrix_multiply_int8_mpi(A_q.data(), B_q.data(), C_int.data(), rank, size, n);
+        } else {
+            vector<int16_t> A_q(count), B_q(count);
+            scale = quantize_symmetric(A, A_q.data(), (long)count, max_level) *
+                    quantize_symmetric(B, B_q.data(), (long)count, max_level);
+            matrix_multiply_int16_mpi(A_q.data(), B_q.data(), C_int.data(), rank, size, n);
+        }
+        for (size_t x = 0; x < count; x++) C[x] = C_int[x] * scale;
+    } else {
+        vector<uint16_t> A_h(count), B_h(count);
+        bool bf16 = (precision == LOWP_BF16);
+        #pragma omp parallel for
+        for (long x = 0; x < (long)count; x++) {
+            A_h[x] = bf16 ? float_to_bf16((float)A[x]) : float_to_fp16((float)A[x]);
+            B_h[x] = bf16 ? float_to_bf16((float)B[x]) : float_to_fp16((float)B[x]);
+        }
+        vector<float> C_f(count);
+        if (bf16) {
+            matrix_multiply_bf16_mpi(A_h.data(), B_h.data(), C_f.data(), rank, size, n);
+        } else {
+            matrix_multiply_fp16_mpi(A_h.data(), B_h.data(), C_f.data(), rank, size, n);
+        }
+        for (size_t x = 0; x < count; x++) C[x] = C_f[x];
+    }
+    
+    if (rank != 0) return 0.0;
+    double diff = 0.0, norm = 0.0;
+    for (size_t x = 0; x < (size_t)block_rows(0, n / size, size, n) * n; x++) {
+        diff += (C[x] - C_ref[x]) * (C[x] - C_ref[x]);
+        norm += C_ref[x] * C_ref[x];
+    }
+    return (norm > 0.0) ? sqrt(diff / norm) : sqrt(diff);
+}
+
+// ===== Analytical performance model =====
+//
+// Alpha-beta communication model (latency + time per byte) calibrated with
+// a ping-pong between ranks 0 and 1 and an allgather sweep, plus a roofline
+// compute model calibrated with the multiply kernel (flop rate) and a triad
+// (memory bandwidth). Predictions cover the engines in this file; they are
+// written as JSON for schedulers and for scripts/visualize.py.
+
+struct MachineParams {
+    double alpha;           // Point-to-point latency (s)
+    double beta;            // Point-to-point time per byte (s/B)
+    double coll_alpha;      // Allgather latency term (s)
+    double coll_beta;       // Allgather time per byte received (s/B)
+    double flop_rate;       // Multiply-kernel flop/s per rank (all threads)
+    double mem_bandwidth;   // Triad bytes/s per rank out of cache (all threads)
+    double cache_bandwidth; // Triad bytes/s per rank on a cache-resident set
+    double cache_bytes;     // Working set below which cache_bandwidth applies
+    bool comm_calibrated;   // False when run on a single rank
+    
+    MachineParams() : alpha(1e-6), beta(1e-10), coll_alpha(2e-6), coll_beta(1e-10),
+                      flop_rate(1e9), mem_bandwidth(1e10), cache_bandwidth(3e10),
+                      cache_bytes(8.0 * 1024 * 1024), comm_calibrated(false) {}
+    
+    // Bandwidth seen by a sweep over working_set bytes
+    double bandwidth_for(double working_set) const {
+        return (working_set <= cache_bytes) ? cache_bandwidth : mem_bandwidth;
+    }
+};
+
+struct ModelPrediction {
+    string algorithm;
+    int n;
+    int procs;
+    double compute_time;
+    double comm_time;
+    double total_time;
+};
+
+const char* MACHINE_PARAMS_FILE = "results/machine_params.conf";
+
+// Least-squares fit of y = a + b * x, weighted by 1/y^2 so the small
+// (latency-bound) samples are not swamped by the large ones
+static void fit_linear(const vector<double>& x, const vector<double>& y, double* a, double* b) {
+    double sw = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        double w = (y[i] > 0.0) ? 1.0 / (y[i] * y[i]) : 1.0;
+        sw += w;
+        sx += w * x[i];
+        sy += w * y[i];
+        sxx += w * x[i] * x[i];
+        sxy += w * x[i] * y[i];
+    }
+    double denom = sw * sxx - sx * sx;
+    *b = (denom != 0.0) ? (sw * sxy - sx * sy) / denom : 0.0;
+    *a = (sy - *b * sx) / sw;
+    if (*a < 0.0) *a = 0.0;
+    if (*b < 0.0) *b = 0.0;
+}
+
+// Calibrate on the current communicator; every rank returns the same values
+MachineParams calibrate_machine(int rank, int size) {
+    MachineParams m;
+    const int reps = 20;
+    
+    // Ping-pong between ranks 0 and 1
+    if (size > 1) {
+        vector<double> xs, ys;
+        vector<char> buf(1 << 22);
+        for (int bytes = 8; bytes <= (1 << 22); bytes *= 8) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double t0 = MPI_Wtime();
+            for (int r = 0; r < reps; r++) {
+                if (rank == 0) {
+                    MPI_Send(buf.data(), bytes, MPI_BYTE, 1, 0, MPI_COMM_WORLD);
+                    MPI_Recv(buf.data(), bytes, MPI_BYTE, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                } else if (rank == 1) {
+                    MPI_Recv(buf.data(), bytes, MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                    MPI_Send(buf.data(), bytes, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+                }
+            }
+            xs.push_back(bytes);
+            ys.push_back((MPI_Wtime() - t0) / (2.0 * reps));
+        }
+        fit_linear(xs, ys, &m.alpha, &m.beta);
+        
+        // Allgather sweep: time against bytes received per rank
+        xs.clear();
+        ys.clear();
+        for (int bytes = 1024; bytes <= (1 << 20); bytes *= 8) {
+            vector<char> send(bytes), recv((size_t)bytes * size);
+            MPI_Barrier(MPI_COMM_WORLD);
+            double t0 = MPI_Wtime();
+            for (int r = 0; r < reps; r++) {
+                MPI_Allgather(send.data(), bytes, MPI_BYTE, recv.data(), bytes, MPI_BYTE,
+                              MPI_COMM_WORLD);
+            }
+            double t = (MPI_Wtime() - t0) / reps, t_max;
+            MPI_Allreduce(&t, &t_max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            xs.push_back((double)bytes * (size - 1));
+            ys.push_back(t_max);
+        }
+        fit_linear(xs, ys, &m.coll_alpha, &m.coll_beta);
+        m.comm_calibrated = true;
+    }
+    
+    // Multiply kernel rate (same loop shape as matrix_multiply_mpi)
+    {
+        int n = 256;
+        vector<double> A((size_t)n * n, 1.0), B((size_t)n * n, 0.5), C((size_t)n * n);
+        double t0 = MPI_Wtime();
+        #pragma omp parallel for collapse(2)
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                double sum = 0.0;
+                for (int k = 0; k < n; k++) {
+                    sum += A[i * n + k] * B[k * n + j];
+                }
+                C[i * n + j] = sum;
+            }
+        }
+        m.flop_rate = 2.0 * n * n * n / (MPI_Wtime() - t0);
+    }
+    
+    // Triad bandwidth, out of cache (96 MB) and cache resident (768 KB)
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l3 > 0) m.cache_bytes = (double)l3;
+#endif
+    long lens[2] = {1L << 22, 1L << 15};
+    int sweeps[2] = {3, 400};
+    double* bw[2] = {&m.mem_bandwidth, &m.cache_bandwidth};
+    for (int t = 0; t < 2; t++) {
+        long len = lens[t];
+        vector<double> a(len, 1.0), b(len, 2.0), c(len, 0.0);
+        double t0 = MPI_Wtime();
+        for (int r = 0; r < sweeps[t]; r++) {
+            #pragma omp parallel for
+            for (long i = 0; i < len; i++) {
+                c[i] = a[i] + 0.5 * b[i];
+            }
+        }
+        *bw[t] = 3.0 * sweeps[t] * len * sizeof(double) / (MPI_Wtime() - t0);
+    }
+    
+    // Compute rates: slowest rank; communication: rank 0's fit
+    double rates[3] = {m.flop_rate, m.mem_bandwidth, m.cache_bandwidth}, min_rates[3];
+    MPI_Allreduce(rates, min_rates, 3, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    m.flop_rate = min_rates[0];
+    m.mem_bandwidth = min_rates[1];
+    m.cache_bandwidth = min_rates[2];
+    double comm[4] = {m.alpha, m.beta, m.coll_alpha, m.coll_beta};
+    MPI_Bcast(comm, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    m.alpha = comm[0];
+    m.beta = comm[1];
+    m.coll_alpha = comm[2];
+    m.coll_beta = comm[3];
+    
+    return m;
+}
+
+void save_machine_params(const MachineParams& m, const string& filename) {
+    ofstream f(filename.c_str());
+    f << setprecision(10);
+    f << "alpha=" << m.alpha << endl;
+    f << "beta=" << m.beta << endl;
+    f << "coll_alpha=" << m.coll_alpha << endl;
+    f << "coll_beta=" << m.coll_beta << endl;
+    f << "flop_rate=" << m.flop_rate << endl;
+    f << "mem_bandwidth=" << m.mem_bandwidth << endl;
+    f << "cache_bandwidth=" << m.cache_bandwidth << endl;
+    f << "cache_bytes=" << m.cache_bytes << endl;
+    f << "comm_calibrated=" << (m.comm_calibrated ? 1 : 0) << endl;
+}
+
+// Returns false (and leaves defaults) when the file does not exist
+bool load_machine_params(MachineParams* m, const string& filename) {
+    ifstream f(filename.c_str());
+    if (!f.is_open()) return false;
+    string line;
+    while (getline(f, line)) {
+        size_t eq = line.find('=');
+        if (eq == string::npos) continue;
+        string key = line.substr(0, eq);
+        double value = atof(line.substr(eq + 1).c_str());
+        if (key == "alpha") m->alpha = value;
+        else if (key == "beta") m->beta = value;
+        else if (key == "coll_alpha") m->coll_alpha = value;
+        else if (key == "coll_beta") m->coll_beta = value;
+        else if (key == "flop_rate") m->flop_rate = value;
+        else if (key == "mem_bandwidth") m->mem_bandwidth = value;
+        else if (key == "cache_bandwidth") m->cache_bandwidth = value;
+        else if (key == "cache_bytes") m->cache_bytes = value;
+        else if (key == "comm_calibrated") m->comm_calibrated = (value != 0.0);
+    }
+    return true;
+}
+
+static ModelPrediction make_prediction(const string& algorithm, int n, int procs,
+                                       double compute, double comm, double total) {
+    ModelPrediction p;
+    p.algorithm = algorithm;
+    p.n = n;
+    p.procs = procs;
+    p.compute_time = compute;
+    p.comm_time = comm;
+    p.total_time = total;
+    return p;
+}
+
+// Row-striped multiply; output_root streams the result to rank 0 behind
+// compute, otherwise C stays distributed
+ModelPrediction predict_multiply(const MachineParams& m, int n, int P, bool output_root,
+                                 bool abft = false) {
+    double N = n;
+    double compute = 2.0 * N * N * N / (P * m.flop_rate);
+    if (abft) compute *= 1.0 + 2.0 / 64.0;
+    double comm = 0.0, total = compute;
+    if (output_root && P > 1) {
+        double chunks = ceil(N * (P - 1) / P / GATHER_CHUNK_ROWS);
+        comm = chunks * m.alpha + 8.0 * N * N * (P - 1) / P * m.beta;
+        double tail = m.alpha + 8.0 * GATHER_CHUNK_ROWS * N * m.beta;
+        total = max(compute, comm) + tail;
+    }
+    string name = abft ? "row_striped_abft" :
+                  (output_root ? "row_striped_root" : "row_striped_distributed");
+    return make_prediction(name, n, P, compute, comm, total);
+}
+
+// Gauss-Jordan inverse: row updates are axpys (2 flops per 16 bytes moved),
+// so they sit on the bandwidth roof; plus two allgathers of the full
+// matrices per column
+ModelPrediction predict_inverse(const MachineParams& m, int n, int P) {
+    double N = n;
+    double bytes = 2.0 * 2.0 * 8.0 * N * N * N / P;
+    double working_set = 2.0 * 8.0 * N * N / P;
+    double compute = bytes / m.bandwidth_for(working_set);
+    double comm = 0.0;
+    if (P > 1) {
+        comm = N * 2.0 * (m.coll_alpha + m.coll_beta * 8.0 * N * N * (P - 1) / P);
+    }
+    return make_prediction("gauss_jordan_inverse", n, P, compute, comm, compute + comm);
+}
+
+// LU-based log-determinant: bandwidth-bound rank-1 updates plus per-column
+// pivot allreduce and pivot-row broadcast (binomial trees)
+ModelPrediction predict_logdet(const MachineParams& m, int n, int P) {
+    double N = n;
+    double bytes = 16.0 * N * N * N / (3.0 * P);
+    double working_set = 8.0 * N * N / P;
+    double compute = bytes / m.bandwidth_for(working_set);
+    double comm = 0.0;
+    if (P > 1) {
+        double hops = ceil(log2((double)P));
+        comm = N * 3.0 * m.alpha * hops + 8.0 * N * N / 2.0 * m.beta * hops;
+    }
+    return make_prediction("lu_logdet", n, P, compute, comm, compute + comm);
+}
+
+vector<ModelPrediction> predict_all(const MachineParams& m, int mult_n, int inv_n,
+                                    const vector<int>& procs) {
+    vector<ModelPrediction> out;
+    for (size_t i = 0; i < procs.size(); i++) {
+        int P = procs[i];
+        out.push_back(predict_multiply(m, mult_n, P, true));
+        out.push_back(predict_multiply(m, mult_n, P, false));
+        out.push_back(predict_multiply(m, mult_n, P, true, true));
+        out.push_back(predict_inverse(m, inv_n, P));
+        out.push_back(predict_logdet(m, inv_n, P));
+    }
+    return out;
+}
+
+void write_model_json(const MachineParams& m, const vector<ModelPrediction>& preds,
+                      int calib_procs, int threads, const string& filename) {
+    ofstream f(filename.c_str());
+    f << setprecision(10);
+    f << "{" << endl;
+    f << "  \"calibration_procs\": " << calib_procs << "," << endl;
+    f << "  \"threads_per_proc\": " << threads << "," << endl;
+    f << "  \"machine\": {" << endl;
+    f << "    \"alpha\": " << m.alpha << "," << endl;
+    f << "    \"beta\": " << m.beta << "," << endl;
+    f << "    \"coll_alpha\": " << m.coll_alpha << "," << endl;
+    f << "    \"coll_beta\": " << m.coll_beta << "," << endl;
+    f << "    \"flop_rate\": " << m.flop_rate << "," << endl;
+    f << "    \"mem_bandwidth\": " << m.mem_bandwidth << "," << endl;
+    f << "    \"cache_bandwidth\": " << m.cache_bandwidth << "," << endl;
+    f << "    \"cache_bytes\": " << m.cache_bytes << "," << endl;
+    f << "    \"comm_calibrated\": " << (m.comm_calibrated ? "true" : "false") << endl;
+    f << "  }," << endl;
+    f << "  \"predictions\": [" << endl;
+    for (size_t i = 0; i < preds.size(); i++) {
+        const ModelPrediction& p = preds[i];
+        f << "    {\"algorithm\": \"" << p.algorithm << "\", \"n\": " << p.n
+          << ", \"procs\": " << p.procs << ", \"compute_time\": " << p.compute_time
+          << ", \"comm_time\": " << p.comm_time << ", \"total_time\": " << p.total_time
+          << "}" << (i + 1 < preds.size() ? "," : "") << endl;
+    }
+    f << "  ]" << endl;
+    f << "}" << endl;
+}
+
+// ===== Automatic algorithm selection =====
+//
+// The dispatcher sits in front of the multiply and inverse entry points.
+// It scores the engines that fit the shape with the analytical model above,
+// checks them against the memory available per rank, picks the engine and
+// its parameters (panel compression, replicated vs distributed inverse) and
+// logs the decision with its reasons to stdout and results/dispatch_log.txt.
+// Machine parameters come from results/machine_params.conf (written by
+// --model) or are calibrated on the spot.
+
+struct ExecutionPlan {
+    string algorithm;
+    CompressionMode compression;
+    double predicted_time;
+    double memory_per_rank;     // Bytes
+    vector<string> reasons;
+    
+    ExecutionPlan() : compression(COMPRESS_NONE), predicted_time(0.0),
+                      memory_per_rank(0.0) {}
+};
+
+struct Dispatcher {
+    bool initialized;
+    MachineParams machine;
+    double memory_budget;       // Bytes available per rank
+    bool user_compression;      // An explicit --compress wins over the plan
+    
+    Dispatcher() : initialized(false), memory_budget(0.0), user_compression(false) {}
+};
+
+static Dispatcher g_dispatcher;
+
+const char* DISPATCH_LOG_FILE = "results/dispatch_log.txt";
+
+static string format_seconds(double t) {
+    stringstream ss;
+    ss << setprecision(3) << t << " s";
+    return ss.str();
+}
+
+static string format_mib(double bytes) {
+    stringstream ss;
+    ss << fixed << setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB";
+    return ss.str();
+}
+
+// MemAvailable shared by the ranks of this node
+static double available_memory_per_rank() {
+    ifstream meminfo("/proc/meminfo");
+    string key;
+    double kib = 0.0;
+    string unit;
+    while (meminfo >> key >> kib >> unit) {
+        if (key == "MemAvailable:") {
+            return kib * 1024.0 / max(1, g_topology.node_size);
+        }
+    }
+    return 0.0;
+}
+
+// memory_budget_mib <= 0 uses MemAvailable; collective
+void dispatcher_init(int rank, int size, double memory_budget_mib, bool user_compression) {
+    Dispatcher& d = g_dispatcher;
+    int loaded = 0;
+    if (rank == 0) {
+        loaded = load_machine_params(&d.machine, MACHINE_PARAMS_FILE) ? 1 : 0;
+    }
+    MPI_Bcast(&loaded, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (loaded) {
+        double values[8] = {d.machine.alpha, d.machine.beta, d.machine.coll_alpha,
+                            d.machine.coll_beta, d.machine.flop_rate, d.machine.mem_bandwidth,
+                            d.machine.cache_bandwidth, d.machine.cache_bytes};
+        MPI_Bcast(values, 8, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        d.machine.alpha = values[0];
+        d.machine.beta = values[1];
+        d.machine.coll_alpha = values[2];
+        d.machine.coll_beta = values[3];
+        d.machine.flop_rate = values[4];
+        d.machine.mem_bandwidth = values[5];
+        d.machine.cache_bandwidth = values[6];
+        d.machine.cache_bytes = values[7];
+    } else {
+        d.machine = calibrate_machine(rank, size);
+    }
+    
+    double budget = (memory_budget_mib > 0.0) ? memory_budget_mib * 1024.0 * 1024.0
+                                              : available_memory_per_rank();
+    MPI_Allreduce(&budget, &d.memory_budget, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    d.user_compression = user_compression;
+    d.initialized = true;
+}
+
+// Compression is planned when predicted compute falls below the same
+// fraction of communication the runtime auto mode uses. `mode` is what the
+// operation can apply: auto only where it re-decides while it runs.
+static void plan_compression(ExecutionPlan& plan, const ModelPrediction& pred,
+                             double extra_bytes, int size, CompressionMode mode) {
+    if (g_dispatcher.user_compression) {
+        plan.reasons.push_back("panel compression left as requested on the command line");
+        return;
+    }
+    if (size == 1 || pred.comm_time <= 0.0) {
+        plan.reasons.push_back("no communication to compress");
+        return;
+    }
+    if (pred.compute_time >= AUTO_COMPRESS_RATIO * pred.comm_time) {
+        plan.reasons.push_back("compute (" + format_seconds(pred.compute_time) +
+                               ") hides communication (" + format_seconds(pred.comm_time) +
+                               "), no compression");
+        return;
+    }
+    if (plan.memory_per_rank + extra_bytes > g_dispatcher.memory_budget) {
+        plan.reasons.push_back("communication-bound but compression buffers (" +
+                               format_mib(extra_bytes) + ") exceed the memory budget");
+        return;
+    }
+    plan.compression = mode;
+    plan.memory_per_rank += extra_bytes;
+    plan.reasons.push_back("communication-bound (comm " + format_seconds(pred.comm_time) +
+                           " vs compute " + format_seconds(pred.compute_time) + "), " +
+                           (mode == COMPRESS_AUTO ? "adaptive lossless compression"
+                                                  : "lossless compression"));
+}
+
+ExecutionPlan plan_multiply(int n, int size, OutputDistribution output, bool abft) {
+    const MachineParams& m = g_dispatcher.machine;
+    ExecutionPlan plan;
+    
+    // Every rank holds full A, B and C
+    plan.memory_per_rank = 3.0 * 8.0 * n * n;
+    ModelPrediction pred = predict_multiply(m, n, size, output == OUTPUT_ROOT, abft);
+    if (output == OUTPUT_ALLGATHER && size > 1) {
+        double allgather = m.coll_alpha + m.coll_beta * 8.0 * n * n * (size - 1) / size;
+        pred.comm_time += allgather;
+        pred.total_time += allgather;
+    }
+    plan.algorithm = pred.algorithm;
+    plan.predicted_time = pred.total_time;
+    plan.reasons.push_back(string("row-striped engine (the only double-precision multiply);") +
+                           (abft ? " ABFT requested;" : "") + " predicted " +
+                           format_seconds(pred.total_time));
+    if (plan.memory_per_rank > g_dispatcher.memory_budget) {
+        plan.reasons.push_back("WARNING: needs " + format_mib(plan.memory_per_rank) +
+                               " per rank, budget is " + format_mib(g_dispatcher.memory_budget));
+    } else {
+        plan.reasons.push_back("needs " + format_mib(plan.memory_per_rank) + " of " +
+                               format_mib(g_dispatcher.memory_budget) + " per rank");
+    }
+    
+    // Only the streamed root gather (not ABFT's) and the allgather compress;
+    // the multiply decides once, after its exchanges, so plan a fixed mode.
+    // Rank 0 keeps one compressed buffer per incoming chunk.
+    if (output == OUTPUT_ALLGATHER || (output == OUTPUT_ROOT && !abft)) {
+        double extra = (output == OUTPUT_ROOT) ? 8.0 * n * n * (size - 1) / size : 0.0;
+        plan_compression(plan, pred, extra, size, COMPRESS_LOSSLESS);
+    } else {
+        plan.reasons.push_back("result exchange is not compressible, no compression");
+    }
+    return plan;
+}
+
+ExecutionPlan plan_inverse(int n, int size) {
+    const MachineParams& m = g_dispatcher.machine;
+    ExecutionPlan plan;
+    
+    // A, the working copy and A_inv, both variants
+    plan.memory_per_rank = 3.0 * 8.0 * n * n;
+    ModelPrediction distributed = predict_inverse(m, n, size);
+    ModelPrediction replicated = predict_inverse(m, n, 1);
+    
+    if (size > 1 && replicated.total_time < distributed.total_time) {
+        plan.algorithm = "gauss_jordan_replicated";
+        plan.predicted_time = replicated.total_time;
+        plan.reasons.push_back("redundant elimination (" + format_seconds(replicated.total_time) +
+                               ") beats distributed elimination with allgathers (" +
+                               format_seconds(distributed.total_time) + ")");
+        plan.reasons.push_back("no communication, every rank holds the inverse");
+    } else {
+        plan.algorithm = "gauss_jordan_distributed";
+        plan.predicted_time = distributed.total_time;
+        plan.reasons.push_back("distributed elimination predicted " +
+                               format_seconds(distributed.total_time) +
+                               (size > 1 ? " vs replicated " +
+                                           format_seconds(replicated.total_time) : ""));
+    }
+    if (plan.memory_per_rank > g_dispatcher.memory_budget) {
+        plan.reasons.push_back("WARNING: needs " + format_mib(plan.memory_per_rank) +
+                               " per rank, budget is " + format_mib(g_dispatcher.memory_budget));
+    } else {
+        plan.reasons.push_back("needs " + format_mib(plan.memory_per_rank) + " of " +
+                               format_mib(g_dispatcher.memory_budget) + " per rank");
+    }
+    if (plan.algorithm == "gauss_jordan_distributed") {
+        // Compressed copies of both replicated matrices
+        plan_compression(plan, distributed, 2.0 * 8.0 * n * n, size, COMPRESS_AUTO);
+    }
+    return plan;
+}
+
+void log_plan(const string& operation, const ExecutionPlan& plan, int rank, int size, int n) {
+    if (rank != 0) return;
+    const char* compression_names[] = {"none", "lossless", "lossy", "auto"};
+    stringstream ss;
+    ss << operation << " n=" << n << " P=" << size << " -> " << plan.algorithm
+       << " (compression " << compression_names[plan.compression] << ")" << endl;
+    for (size_t i = 0; i < plan.reasons.size(); i++) {
+        ss << "     - " << plan.reasons[i] << endl;
+    }
+    cout << "   Dispatch: " << ss.str();
+    
+    ofstream logfile(DISPATCH_LOG_FILE, ios::app);
+    logfile << ss.str();
+}
+
+// Runs with the plan's compression unless the user chose one explicitly
+class PlannedCompression {
+    CompressionPolicy saved;
+public:
+    explicit PlannedCompression(const ExecutionPlan& plan) : saved(g_compression) {
+        if (!g_dispatcher.user_compression) {
+            compression_configure(plan.compression, saved.tolerance);
+        }
+    }
+    ~PlannedCompression() { g_compression = saved; }
+};
+
+void matrix_multiply_auto_mpi(double* A, double* B, double* C, int rank, int size, int n,
+                              OutputDistribution output = OUTPUT_ROOT) {
+    ExecutionPlan plan = plan_multiply(n, size, output, false);
+    log_plan("Multiply", plan, rank, size, n);
+    PlannedCompression scope(plan);
+    matrix_multiply_mpi(A, B, C, rank, size, n, output);
+}
+
+AbftReport matrix_multiply_abft_auto_mpi(double* A, double* B, double* C, int rank, int size,
+                                         int n, const AbftOptions& opts,
+                                         OutputDistribution output = OUTPUT_ROOT) {
+    ExecutionPlan plan = plan_multiply(n, size, output, true);
+    log_plan("Multiply", plan, rank, size, n);
+    PlannedCompression scope(plan);
+    return matrix_multiply_abft_mpi(A, B, C, rank, size, n, opts, output);
+}
+
+void matrix_inverse_auto_mpi(const double* A, double* A_inv, int rank, int size, int n,
+                             OutputDistribution output = OUTPUT_ALLGATHER) {
+    ExecutionPlan plan = plan_inverse(n, size);
+    log_plan("Inverse", plan, rank, size, n);
+    if (plan.algorithm == "gauss_jordan_replicated") {
+        if (!matrix_inverse_replicated(A, A_inv, n) && rank == 0) {
+            cout << "Matrix is singular!" << endl;
+        }
+        return;
+    }
+    PlannedCompression scope(plan);
+    if (!matrix_inverse_mpi(A, A_inv, rank, size, n, output) && rank == 0) {
+        cout << "Matrix is singular!" << endl;
+    }
+}
+
+// mkdir -p with mkdir(2): true once path is a directory
+bool make_directories(const string& path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        string dir = path.substr(0, pos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (pos == string::npos) break;
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// ===== Storage cache tier =====
+/*
+ * Node-local mirror of the shared-storage matrix parts (--cache-dir, e.g.
+ * a scratch SSD). Every part file gets a "<part>.sum" sidecar holding its
+ * size and checksum. A local copy is used only when its sidecar matches the
+ * shared one and its bytes hash to that sum; otherwise the part is read
+ * from shared storage and mirrored again. Each rank's cache is bounded
+ * (--cache-mib) with least-recently-used eviction by file mtime.
+ *
+ * With --cache-write-back a save lands in the cache and a background thread
+ * copies it to shared storage; storage_cache_drain() waits for the copies.
+ * A part stays pinned (never evicted) until its copy succeeds; a failed
+ * copy keeps it pinned, since the cache holds its only copy, and makes
+ * storage_cache_drain() report failure.
+ */
+
+struct StorageCache {
+    bool enabled;
+    bool write_back;
+    string dir;                     // Per-rank directory under --cache-dir
+    size_t capacity;                // Bytes
+    std::atomic<size_t> hits, misses;   // Also updated by prefetch threads
+    set<string> pending;            // Shared paths not yet on shared storage
+    set<string> failed;             // Of those, the ones whose drain failed
+    vector<pair<string, std::thread> > drains;  // Shared path, copying thread
+    std::mutex lock;
+    
+    StorageCache() : enabled(false), write_back(false), capacity(0), hits(0), misses(0) {}
+};
+
+static StorageCache g_cache;
+
+const double DEFAULT_CACHE_MIB = 4096.0;
+
+// FNV-1a over 64-bit words (and the byte tail)
+uint64_t part_checksum(const char* data, size_t bytes) {
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t h = 14695981039346656037ULL;
+    size_t words = bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) {
+        uint64_t w;
+        memcpy(&w, data + i * sizeof(uint64_t), sizeof(uint64_t));
+        h = (h ^ w) * prime;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < bytes; i++) {
+        h = (h ^ (unsigned char)data[i]) * prime;
+    }
+    return h;
+}
+
+// Write to "<path>.tmp" and rename, so path only ever holds a complete file
+bool write_part_file(const string& path, const char* data, size_t bytes, bool sync) {
+    string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t w = write(fd, data + done, bytes - done);
+        if (w <= 0) {
+            close(fd);
+            unlink(tmp.c_str());
+            return false;
+        }
+        done += (size_t)w;
+    }
+    if (sync) fsync(fd);
+    close(fd);
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool read_part_file(const string& path, char* data, size_t bytes) {
+    ifstream file(path.c_str(), ios::binary);
+    if (!file.is_open()) return false;
+    file.read(data, bytes);
+    return (size_t)file.gcount() == bytes;
+}
+
+void write_part_sum(const string& path, size_t bytes, uint64_t sum) {
+    stringstream ss;
+    ss << bytes << " " << hex << sum << "\n";
+    string text = ss.str();
+    write_part_file(path + ".sum", text.data(), text.size(), false);
+}
+
+bool read_part_sum(const string& path, size_t& bytes, uint64_t& sum) {
+    ifstream f((path + ".sum").c_str());
+    return static_cast<bool>(f >> bytes >> hex >> sum);
+}
+
+string cache_path(const string& shared_path) {
+    string flat = shared_path;
+    replace(flat.begin(), flat.end(), '/', '_');
+    return g_cache.dir + "/" + flat;
+}
+
+// Cache files are changed by the main thread and the prefetch thread; every
+// store, eviction and removal holds g_cache.lock. *_locked: caller holds it.
+
+static bool cache_pinned_locked(const string& local_path) {
+    for (set<string>::iterator it = g_cache.pending.begin(); it != g_cache.pending.end(); ++it) {
+        if (cache_path(*it) == local_path) return true;
+    }
+    return false;
+}
+
+static void cache_remove_locked(const string& local_path) {
+    unlink(local_path.c_str());
+    unlink((local_path + ".sum").c_str());
+}
+
+// Drop a cached part unless it is waiting to be drained (its only copy)
+void cache_remove(const string& local_path) {
+    std::lock_guard<std::mutex> guard(g_cache.lock);
+    if (!cache_pinned_locked(local_path)) cache_remove_locked(local_path);
+}
+
+// Drop least-recently-used parts until `incoming` more bytes fit
+static void cache_evict_locked(size_t incoming) {
+    DIR* d = opendir(g_cache.dir.c_str());
+    if (!d) return;
+    vector<pair<time_t, pair<size_t, string> > > files;
+    size_t used = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        string name = entry->d_name;
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".dat") != 0) continue;
+        string path = g_cache.dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        files.push_back(make_pair(st.st_mtime, make_pair((size_t)st.st_size, path)));
+        used += st.st_size;
+    }
+    closedir(d);
+    
+    sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() && used + incoming > g_cache.capacity; i++) {
+        if (cache_pinned_locked(files[i].second.second)) continue;
+        cache_remove_locked(files[i].second.second);
+        used -= files[i].second.first;
+    }
+}
+
+
+void cache_init(const string& dir, double capacity_mib, bool write_back, int rank) {
+    stringstream ss;
+    ss << dir << "/rank" << rank;
+    g_cache.dir = ss.str();
+    g_cache.capacity = (size_t)(capacity_mib * 1024.0 * 1024.0);
+    g_cache.write_back = write_back;
+    g_cache.enabled = make_directories(g_cache.dir);
+    if (!g_cache.enabled) {
+        cerr << "Rank " << rank << ": cannot create cache directory " << g_cache.dir
+             << ", reading shared storage directly" << endl;
+    }
+}
+
+bool cache_is_pending(const string& shared_path) {
+    std::lock_guard<std::mutex> guard(g_cache.lock);
+    return g_cache.pending.count(shared_path) > 0;
+}
+
+// Read a part from the cache; false on a miss or a copy that fails validation
+bool cache_load(const string& shared_path, char* data, size_t bytes) {
+    string local = cache_path(shared_path);
+    size_t local_bytes, shared_bytes;
+    uint64_t local_sum, shared_sum;
+    if (!read_part_sum(local, local_bytes, local_sum) || local_bytes != bytes) {
+        g_cache.misses++;
+        return false;
+    }
+    // A part still draining has no shared copy yet; the local one is newest
+    if (!cache_is_pending(shared_path) &&
+        (!read_part_sum(shared_path, shared_bytes, shared_sum) ||
+         shared_bytes != local_bytes || shared_sum != local_sum)) {
+        cache_remove(local);
+        g_cache.misses++;
+        return false;
+    }
+    if (!read_part_file(local, data, bytes) || part_checksum(data, bytes) != local_sum) {
+        cache_remove(local);
+        g_cache.misses++;
+        return false;
+    }
+    utime(local.c_str(), NULL);     // LRU touch
+    g_cache.hits++;
+    return true;
+}
+
+// False if the part was not cached
+bool cache_store(const string& shared_path, const char* data, size_t bytes, uint64_t sum) {
+    if (bytes > g_cache.capacity) return false;
+    std::lock_guard<std::mutex> guard(g_cache.lock);
+    cache_evict_locked(bytes);
+    string local = cache_path(shared_path);
+    if (!write_part_file(local, data, bytes, false)) return false;
+    write_part_sum(local, bytes, sum);
+    return true;
+}
+
+// Background copy of a written-back part to shared storage
+void cache_drain_part(string local, string shared_path, size_t bytes, uint64_t sum) {
+    vector<char> buffer(bytes);
+    bool ok = read_part_file(local, buffer.data(), bytes) &&
+              part_checksum(buffer.data(), bytes) == sum &&
+              write_part_file(shared_path, buffer.data(), bytes, true);
+    if (ok) write_part_sum(shared_path, bytes, sum);
+    
+    std::lock_guard<std::mutex> guard(g_cache.lock);
+    if (ok) {
+        g_cache.pending.erase(shared_path);
+    } else {
+        g_cache.failed.insert(shared_path);     // Stays pinned
+    }
+}
+
+// Wait for the drains of one shared path (main thread only)
+void cache_wait_drain(const string& shared_path) {
+    for (size_t i = 0; i < g_cache.drains.size();) {
+        if (g_cache.drains[i].first == shared_path) {
+            g_cache.drains[i].second.join();
+            g_cache.drains.erase(g_cache.drains.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Wait for all write-back copies; false if any part failed to reach shared
+// storage (it is listed, with the cached copy that still holds it)
+bool storage_cache_drain() {
+    for (size_t i = 0; i < g_cache.drains.size(); i++) {
+        g_cache.drains[i].second.join();
+    }
+    g_cache.drains.clear();
+    
+    std::lock_guard<std::mutex> guard(g_cache.lock);
+    for (set<string>::iterator it = g_cache.failed.begin(); it != g_cache.failed.end(); ++it) {
+        cerr << "Failed to drain " << *it << " to shared storage; its only copy is "
+             << cache_path(*it) << endl;
+    }
+    return g_cache.failed.empty();
+}
+
+string part_file_name(const string& filename, int rank) {
+    stringstream ss;
+    ss << filename << "_part" << rank << ".dat";
+    return ss.str();
+}
+
+// Write one rank's part (through the cache in write-back mode)
+void save_part(const string& path, const char* data, size_t bytes) {
+    uint64_t sum = part_checksum(data, bytes);
+    
+    // An older copy of this path still in flight would land after this one
+    if (g_cache.enabled) cache_wait_drain(path);
+    
+    if (g_cache.enabled && g_cache.write_back) {
+        // Pinned before it is written, so no concurrent eviction can take it
+        {
+            std::lock_guard<std::mutex> guard(g_cache.lock);
+            g_cache.pending.insert(path);
+            g_cache.failed.erase(path);         // Superseded
+        }
+        if (cache_store(path, data, bytes, sum)) {
+            g_cache.drains.push_back(make_pair(path, std::thread(cache_drain_part, cache_path(path),
+                                                                 path, bytes, sum)));
+            return;
+        }
+        std::lock_guard<std::mutex> guard(g_cache.lock);
+        g_cache.pending.erase(path);
+    }
+    
+    // Written directly (or the cache could not take it)
+    bool ok = write_part_file(path, data, bytes, false);
+    if (ok) write_part_sum(path, bytes, sum);
+    if (g_cache.enabled && ok) {
+        {
+            std::lock_guard<std::mutex> guard(g_cache.lock);
+            g_cache.pending.erase(path);
+            g_cache.failed.erase(path);
+        }
+        cache_remove(cache_path(path));   // Stale now; mirrored again on the next read
+    }
+}
+
+// Read one rank's part: cache first, then shared storage (mirrored on the way)
+bool load_part(const string& path, char* data, size_t bytes, int rank) {
+    if (g_cache.enabled && cache_load(path, data, bytes)) return true;
+    if (!read_part_file(path, data, bytes)) return false;
+    
+    if (g_cache.enabled) {
+        size_t shared_bytes;
+        uint64_t shared_sum, sum = part_checksum(data, bytes);
+        if (read_part_sum(path, shared_bytes, shared_sum) && shared_sum != sum) {
+            cerr << "Rank " << rank << ": checksum mismatch in " << path
+                 << ", not caching it" << endl;
+            return true;
+        }
+        cache_store(path, data, bytes, sum);
+    }
+    return true;
+}
+
+// Save matrix to distributed storage
+void save_matrix_distributed(double* matrix, int n, const string& filename, 
+                             int rank, int size) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    // This rank's rows are contiguous in the row-major matrix
+    save_part(part_file_name(filename, rank),
+              reinterpret_cast<const char*>(&matrix[(size_t)start_row * n]),
+              (size_t)(end_row - start_row) * n * sizeof(double));
+}
+
+// Load matrix from distributed storage
+void load_matrix_distributed(double* matrix, int n, const string& filename,
+                             int rank, int size) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    load_part(part_file_name(filename, rank),
+              reinterpret_cast<char*>(&matrix[(size_t)start_row * n]),
+              (size_t)(end_row - start_row) * n * sizeof(double), rank);
+}
+
+// ===== Tiled on-disk layout =====
+/*
+ * "<name>.tiles" holds the whole matrix as contiguous tile x tile blocks in
+ * tile-major order (tile row by tile row), behind a 64-byte header. Edge
+ * tiles are zero-padded to full size, so tile (ti, tj) always starts at
+ * header + (ti * tile_cols + tj) * tile^2 * 8 bytes and any 2D block or
+ * column panel is fetched with one sequential read per tile. The same
+ * format is read and written by DistributedStorageManager.save_matrix_tiled.
+ *
+ * Ranks write their row stripes with one collective MPI-IO call, through a
+ * file view listing the (partial) tile rows each stripe covers.
+ */
+
+const char TILED_MAGIC[4] = {'M', 'T', 'I', 'L'};
+const uint32_t TILED_VERSION = 1;
+const int DEFAULT_STORE_TILE = 256;
+
+struct TiledHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t tile;
+    char dtype[8];              // numpy dtype string, "<f8"
+    char reserved[24];
+};
+
+struct TiledFile {
+    TiledHeader header;
+    int fd;
+    
+    uint64_t tile_cols() const { return (header.cols + header.tile - 1) / header.tile; }
+    uint64_t tile_bytes() const { return header.tile * header.tile * sizeof(double); }
+    off_t tile_offset(uint64_t ti, uint64_t tj) const {
+        return (off_t)(sizeof(TiledHeader) + (ti * tile_cols() + tj) * tile_bytes());
+    }
+};
+
+TiledHeader make_tiled_header(int rows, int cols, int tile) {
+    TiledHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TILED_MAGIC, 4);
+    h.version = TILED_VERSION;
+    h.rows = rows;
+    h.cols = cols;
+    h.tile = tile;
+    memcpy(h.dtype, "<f8", 3);
+    return h;
+}
+
+// Write each rank's row stripe (stripe holds only this rank's rows); collective,
+// returns false on every rank if any rank's write failed
+bool save_stripe_tiled(const double* stripe, int n, const string& filename,
+                       int rank, int size, int tile = DEFAULT_STORE_TILE) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    TiledFile layout;
+    layout.header = make_tiled_header(n, n, tile);
+    uint64_t tcols = layout.tile_cols();
+    
+    // One segment per (tile row piece, tile column), already in file order
+    vector<int> lengths;
+    vector<MPI_Aint> offsets;
+    vector<double> packed;
+    for (int ti = start_row / tile; ti * tile < end_row; ti++) {
+        int r0 = max(start_row, ti * tile);
+        int r1 = min(end_row, (ti + 1) * tile);
+        for (uint64_t tj = 0; tj < tcols; tj++) {
+            offsets.push_back(layout.tile_offset(ti, tj) +
+                              (MPI_Aint)(r0 - ti * tile) * tile * sizeof(double));
+            lengths.push_back((r1 - r0) * tile);
+            int c0 = (int)tj * tile;
+            int width = min(tile, n - c0);
+            for (int i = r0; i < r1; i++) {
+                const double* row = &stripe[(size_t)(i - start_row) * n + c0];
+                packed.insert(packed.end(), row, row + width);
+                packed.insert(packed.end(), tile - width, 0.0);
+            }
+        }
+    }
+    
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) cerr << "Cannot open " << filename << " for writing" << endl;
+        return false;
+    }
+    // Every collective call is made even after a failure so ranks stay in
+    // step; the outcome is agreed on once at the end
+    int ok = MPI_File_set_size(fh, layout.tile_offset((n + tile - 1) / tile, 0)) == MPI_SUCCESS;
+    if (rank == 0) {
+        ok = MPI_File_write_at(fh, 0, &layout.header, sizeof(TiledHeader), MPI_BYTE,
+                               MPI_STATUS_IGNORE) == MPI_SUCCESS && ok;
+    }
+    
+    MPI_Datatype filetype;
+    MPI_Type_create_hindexed((int)lengths.size(), lengths.data(), offsets.data(),
+                             MPI_DOUBLE, &filetype);
+    MPI_Type_commit(&filetype);
+    ok = MPI_File_set_view(fh, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL) == MPI_SUCCESS
+         && ok;
+    ok = MPI_File_write_all(fh, packed.data(), (int)packed.size(), MPI_DOUBLE,
+                            MPI_STATUS_IGNORE) == MPI_SUCCESS && ok;
+    MPI_Type_free(&filetype);
+    MPI_File_close(&fh);
+    
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (!ok && rank == 0) cerr << "Writing " << filename << " failed" << endl;
+    return ok != 0;
+}
+
+bool save_matrix_tiled(const double* matrix, int n, const string& filename,
+                       int rank, int size, int tile = DEFAULT_STORE_TILE) {
+    return save_stripe_tiled(&matrix[(size_t)rank * (n / size) * n], n, filename, rank, size, tile);
+}
+
+bool open_tiled(const string& filename, TiledFile& file) {
+    file.fd = open(filename.c_str(), O_RDONLY);
+    if (file.fd < 0) return false;
+    if (pread(file.fd, &file.header, sizeof(TiledHeader), 0) != (ssize_t)sizeof(TiledHeader) ||
+        memcmp(file.header.magic, TILED_MAGIC, 4) != 0 ||
+        strncmp(file.header.dtype, "<f8", 3) != 0) {
+        close(file.fd);
+        return false;
+    }
+    return true;
+}
+
+// Read rows [row0, row0+rows) x cols [col0, col0+cols) into out (row-major,
+// leading dimension ld); each touched tile costs one contiguous read
+bool read_tiled_block(const TiledFile& file, int row0, int col0, int rows, int cols,
+                      double* out, int ld) {
+    int tile = (int)file.header.tile;
+    vector<double> buffer((size_t)tile * tile);
+    for (int ti = row0 / tile; ti * tile < row0 + rows; ti++) {
+        // Rows of this tile the block needs: contiguous inside the tile
+        int r0 = max(row0, ti * tile);
+        int r1 = min(row0 + rows, (ti + 1) * tile);
+        for (int tj = col0 / tile; tj * tile < col0 + cols; tj++) {
+            size_t bytes = (size_t)(r1 - r0) * tile * sizeof(double);
+            off_t offset = file.tile_offset(ti, tj) + (off_t)(r0 - ti * tile) * tile * sizeof(double);
+            if (pread(file.fd, buffer.data(), bytes, offset) != (ssize_t)bytes) return false;
+            int c0 = max(col0, tj * tile);
+            int c1 = min(col0 + cols, (tj + 1) * tile);
+            for (int i = r0; i < r1; i++) {
+                memcpy(&out[(size_t)(i - row0) * ld + (c0 - col0)],
+                       &buffer[(size_t)(i - r0) * tile + (c0 - tj * tile)],
+                       (c1 - c0) * sizeof(double));
+            }
+        }
+    }
+    return true;
+}
+
+// Read this rank's row stripe of a tiled file into stripe
+bool load_stripe_tiled(double* stripe, int n, const string& filename, int rank, int size) {
+    int rows_per_proc = n / size;
+    int start_row = rank * rows_per_proc;
+    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    
+    TiledFile file;
+    if (!open_tiled(filename, file)) return false;
+    bool ok = file.header.rows == (uint64_t)n && file.header.cols == (uint64_t)n &&
+              read_tiled_block(file, start_row, 0, end_row - start_row, n, stripe, n);
+    close(file.fd);
+    return ok;
+}
+
+// Load this rank's row stripe from a tiled file
+bool load_matrix_tiled(double* matrix, int n, const string& filename, int rank, int size) {
+    return load_stripe_tiled(&matrix[(size_t)rank * (n / size) * n], n, filename, rank, size);
+}
+
+// Conversion between the per-rank row-major parts and the tiled layout.
+// Both run with the rank count the parts were (or will be) written with
+// and only hold this rank's stripe.
+bool convert_parts_to_tiled(const string& parts, const string& tiled, int n,
+                            int rank, int size, int tile) {
+    int local_rows = block_rows(rank, n / size, size, n);
+    vector<double> stripe((size_t)local_rows * n);
+    
+    // A missing or short part must not become zero tiles; the write is
+    // collective, so every rank has to agree before it starts
+    int loaded = load_part(part_file_name(parts, rank), reinterpret_cast<char*>(stripe.data()),
+                           stripe.size() * sizeof(double), rank) ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &loaded, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    return loaded && save_stripe_tiled(stripe.data(), n, tiled, rank, size, tile);
+}
+
+bool convert_tiled_to_parts(const string& tiled, const string& parts, int n,
+                            int rank, int size) {
+    int local_rows = block_rows(rank, n / size, size, n);
+    vector<double> stripe((size_t)local_rows * n);
+    if (!load_stripe_tiled(stripe.data(), n, tiled, rank, size)) return false;
+    save_part(part_file_name(parts, rank), reinterpret_cast<const char*>(stripe.data()),
+              stripe.size() * sizeof(double));
+    return true;
+}
+
+// ===== Prefetching loader =====
+/*
+ * prefetch_matrix() starts reading this rank's row stripe of a stored
+ * matrix (a .dat parts prefix or a .tiles file) into a standby buffer on a
+ * background I/O thread and returns at once, so the read overlaps whatever
+ * the rank computes next. prefetch_take() waits for the read and hands the
+ * buffer over by swap, without a copy. Buffers in flight are capped
+ * (--prefetch-mib, default a quarter of MemAvailable per rank): a request
+ * over the cap is refused and the caller loads synchronously, so
+ * prefetching never pushes the node into swap.
+ */
+
+struct PrefetchSlot {
+    vector<double> stripe;
+    std::thread worker;
+    bool ok;
+    
+    PrefetchSlot() : ok(false) {}
+};
+
+struct Prefetcher {
+    size_t cap;                 // Bytes
+    size_t reserved;
+    map<string, PrefetchSlot*> slots;
+    
+    Prefetcher() : cap(0), reserved(0) {}
+};
+
+static Prefetcher g_prefetch;
+
+const double PREFETCH_MEMORY_FRACTION = 0.25;
+
+static bool ends_with(const string& text, const string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// This rank's row stripe of an n x n stored matrix into `stripe`
+bool load_stripe(const string& source, double* stripe, int n, int rank, int size) {
+    int local_rows = block_rows(rank, n / size, size, n);
+    
+    if (ends_with(source, ".tiles")) return load_stripe_tiled(stripe, n, source, rank, size);
+    return load_part(part_file_name(source, rank), reinterpret_cast<char*>(stripe),
+                     (size_t)local_rows * n * sizeof(double), rank);
+}
+
+// cap_mib <= 0 uses PREFETCH_MEMORY_FRACTION of MemAvailable per rank
+void prefetch_init(double cap_mib) {
+    g_prefetch.cap = (cap_mib > 0) ? (size_t)(cap_mib * 1024.0 * 1024.0)
+                                   : (size_t)(PREFETCH_MEMORY_FRACTION * available_memory_per_rank());
+}
+
+// Start loading in the background; false if refused (over the cap or already queued)
+bool prefetch_matrix(const string& source, int n, int rank, int size) {
+    size_t bytes = (size_t)block_rows(rank, n / size, size, n) * n * sizeof(double);
+    if (g_prefetch.slots.count(source) || g_prefetch.reserved + bytes > g_prefetch.cap) {
+        return false;
+    }
+    PrefetchSlot* slot = new PrefetchSlot();
+    slot->stripe.resize(bytes / sizeof(double));
+    g_prefetch.reserved += bytes;
+    g_prefetch.slots[source] = slot;
+    slot->worker = std::thread([slot, source, n, rank, size]() {
+        slot->ok = load_stripe(source, slot->stripe.data(), n, rank, size);
+    });
+    return true;
+}
+
+// Hand over a prefetched stripe (waiting for it), or load it now
+bool prefetch_take(const string& source, vector<double>& stripe, int n, int rank, int size) {
+    map<string, PrefetchSlot*>::iterator it = g_prefetch.slots.find(source);
+    if (it == g_prefetch.slots.end()) {
+        stripe.resize((size_t)block_rows(rank, n / size, size, n) * n);
+        return load_stripe(source, stripe.data(), n, rank, size);
+    }
+    PrefetchSlot* slot = it->second;
+    slot->worker.join();
+    g_prefetch.reserved -= slot->stripe.size() * sizeof(double);
+    g_prefetch.slots.erase(it);
+    stripe.swap(slot->stripe);
+    bool ok = slot->ok;
+    delete slot;
+    return ok;
+}
+
+void prefetch_free() {
+    for (map<string, PrefetchSlot*>::iterator it = g_prefetch.slots.begin();
+         it != g_prefetch.slots.end(); ++it) {
+        it->second->worker.join();
+        delete it->second;
+    }
+    g_prefetch.slots.clear();
+    g_prefetch.reserved = 0;
+}
+
+// Analyze communication bottleneck
+void analyze_communication(int rank, int size, double comp_time, 
+                          double comm_time, const string& filename) {
+    double total_comp_time, total_comm_time;
+    
+    MPI_Reduce(&comp_time, &total_comp_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&comm_time, &total_comm_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    
+    if (rank == 0) {
+        double avg_comp = total_comp_time / size;
+        double avg_comm = total_comm_time / size;
+        double comm_ratio = (avg_comm / (avg_comp + avg_comm)) * 100;
+        
+        ofstream logfile(filename, ios::app);
+        logfile << "Processors: " << size << endl;
+        logfile << "Avg Computation Time: " << avg_comp << " seconds" << endl;
+        logfile << "Avg Communication Time: " << avg_comm << " seconds" << endl;
+        logfile << "Communication Overhead: " << comm_ratio << "%" << endl;
+        logfile << "---" << endl;
+        logfile.close();
+    }
+}
+
+// Machine-readable run summary (rank 0) for sweep orchestration
+struct RunSummary {
+    int procs;
+    int threads;
+    int matrix_size;
+    int inverse_size;
+    double multiply_time;
+    double multiply_comm;
+    double inverse_time;
+    double logdet_time;     // Negative when not run
+    
+    // Weak-scaling mode only
+    bool weak;
+    int weak_base;
+    string weak_scale;
+    int flops_scaled_size;
+    int memory_scaled_size;
+    double multiply_efficiency; // Negative without a baseline
+    double inverse_efficiency;
+    
+    RunSummary() : procs(1), threads(1), matrix_size(0), inverse_size(0),
+                   multiply_time(0.0), multiply_comm(0.0), inverse_time(0.0),
+                   logdet_time(-1.0), weak(false), weak_base(0),
+                   flops_scaled_size(0), memory_scaled_size(0),
+                   multiply_efficiency(-1.0), inverse_efficiency(-1.0) {}
+};
+
+void write_run_json(const RunSummary& r, const string& filename) {
+    ofstream f(filename.c_str());
+    f << setprecision(10);
+    f << "{" << endl;
+    f << "  \"procs\": " << r.procs << "," << endl;
+    f << "  \"threads\": " << r.threads << "," << endl;
+    f << "  \"matrix_size\": " << r.matrix_size << "," << endl;
+    f << "  \"inverse_size\": " << r.inverse_size << "," << endl;
+    f << "  \"multiply_time\": " << r.multiply_time << "," << endl;
+    f << "  \"multiply_comm\": " << r.multiply_comm << "," << endl;
+    f << "  \"inverse_time\": " << r.inverse_time;
+    if (r.logdet_time >= 0.0) {
+        f << "," << endl << "  \"logdet_time\": " << r.logdet_time;
+    }
+    if (r.weak) {
+        f << "," << endl << "  \"weak_base\": " << r.weak_base;
+        f << "," << endl << "  \"weak_scale\": \"" << r.weak_scale << "\"";
+        f << "," << endl << "  \"flops_scaled_size\": " << r.flops_scaled_size;
+        f << "," << endl << "  \"memory_scaled_size\": " << r.memory_scaled_size;
+        if (r.multiply_efficiency >= 0.0) {
+            f << "," << endl << "  \"multiply_efficiency\": " << r.multiply_efficiency;
+        }
+        if (r.inverse_efficiency >= 0.0) {
+            f << "," << endl << "  \"inverse_efficiency\": " << r.inverse_efficiency;
+        }
+    }
+    f << endl << "}" << endl;
+}
+
+// Command-line options
+// Usage: matrix_operations_mpi [num_threads] [--abft] [--abft-inject] [--logdet] [--spd]
+//                              [--output=distributed|root|allgather]
+//                              [--flat-collectives]
+//                              [--compress=none|lossless|lossy|auto] [--compress-tol=<tol>]
+//                              [--model] [--model-procs=1,2,4,8]
+//                              [--auto] [--mem-per-rank=<MiB>]
+//                              [--json=<file>] [--phase-log=<file>] [--size=<n>] [--inverse-size=<n>]
+//                              [--weak=<n1>] [--weak-scale=flops|memory]
+//                              [--weak-inverse=<n1>] [--weak-baseline=<mult_s>,<inv_s>]
+//                              [--cache-dir=<dir>] [--cache-mib=<MiB>] [--cache-write-back]
+//                              [--store-layout=rows|tiled] [--store-tile=<b>]
+//                              [--to-tiled=<parts prefix>] [--to-rows=<file.tiles>]
+//                              [--pipeline=<src>,<src>...] [--no-prefetch] [--prefetch-mib=<MiB>]
+//                              [--lowp=int8|int16|bf16|fp16] [--kron=<m>,<n>]
+//                              [--batched=<n>,<count>]
+// The engine only saves C per rank, so results stay distributed by default.
+struct RunOptions {
+    int num_threads;
+    bool abft;
+    AbftOptions abft_opts;
+    bool logdet;
+    bool spd;                   // --logdet on an SPD matrix via Cholesky
+    OutputDistribution output;
+    bool hierarchical;
+    CompressionMode compression;
+    double compression_tol;
+    bool explicit_compression;
+    bool model;
+    vector<int> model_procs;
+    bool auto_select;
+    double mem_per_rank_mib;
+    string json_file;
+    string phase_log;           // Phase markers for resource_monitor.py
+    int matrix_size;
+    int inverse_size;
+    int weak_base;              // 0 = regular run
+    string weak_scale;
+    int weak_inverse_base;
+    vector<double> weak_baseline;
+    string cache_dir;           // Empty = no cache tier
+    double cache_mib;
+    bool cache_write_back;
+    bool store_tiled;           // Save C as data/matrix_C.tiles
+    int store_tile;
+    string to_tiled;            // Conversion modes (use --size for n)
+    string to_rows;
+    vector<string> pipeline;    // Stored operands, one job each
+    bool prefetch;
+    double prefetch_mib;        // <= 0: a share of MemAvailable
+    LowPrecision low_precision; // Extra reduced-precision multiply
+    vector<int> kron;           // --kron=<m>,<n> check mode
+    vector<int> batched;        // --batched=<n>,<count> check mode
+    string error;               // Set for an invalid argument
+    
+    RunOptions() : num_threads(4), abft(false), logdet(false), spd(false),
+                   output(OUTPUT_DISTRIBUTED), hierarchical(true),
+                   compression(COMPRESS_NONE), compression_tol(1e-6),
+                   explicit_compression(false), model(false),
+                   auto_select(false), mem_per_rank_mib(0.0),
+                   matrix_size(MATRIX_SIZE), inverse_size(INVERSE_SIZE),
+                   weak_base(0), weak_scale("flops"), weak_inverse_base(INVERSE_SIZE),
+                   cache_mib(DEFAULT_CACHE_MIB), cache_write_back(false),
+                   store_tiled(false), store_tile(DEFAULT_STORE_TILE),
+                   prefetch(true), prefetch_mib(0.0), low_precision(LOWP_NONE) {}
+};
+
+vector<int> parse_int_list(const string& text) {
+    vector<int> values;
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+RunOptions parse_options(int argc, char** argv) {
+    RunOptions opts;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--abft") {
+            opts.abft = true;
+        } else if (arg == "--abft-inject") {
+            opts.abft = true;
+            opts.abft_opts.inject_fault = true;
+        } else if (arg == "--logdet") {
+            opts.logdet = true;
+        } else if (arg == "--spd") {
+            opts.logdet = true;
+            opts.spd = true;
+        } else if (arg.compare(0, 9, "--output=") == 0) {
+            if (!parse_output_distribution(arg.substr(9), opts.output)) {
+                opts.error = "unknown output distribution: " + arg;
+            }
+        } else if (arg == "--flat-collectives") {
+            opts.hierarchical = false;
+        } else if (arg.compare(0, 11, "--compress=") == 0) {
+            if (!parse_compression_mode(arg.substr(11), opts.compression)) {
+                opts.error = "unknown compression mode: " + arg;
+            }
+            opts.explicit_compression = true;
+        } else if (arg.compare(0, 7, "--lowp=") == 0) {
+            if (!parse_low_precision(arg.substr(7), opts.low_precision)) {
+                opts.error = "unknown low-precision type: " + arg;
+            }
+        } else if (arg.compare(0, 7, "--kron=") == 0) {
+            opts.kron = parse_int_list(arg.substr(7));
+            if (opts.kron.size() != 2 || opts.kron[0] < 1 || opts.kron[1] < 1) {
+                opts.error = "--kron expects two factor sizes, e.g. --kron=8,6";
+            }
+        } else if (arg.compare(0, 10, "--batched=") == 0) {
+            opts.batched = parse_int_list(arg.substr(10));
+            if (opts.batched.size() != 2 || opts.batched[0] < 1 || opts.batched[1] < 1) {
+                opts.error = "--batched expects an entry size and a count, e.g. --batched=8,100000";
+            }
+        } else if (arg.compare(0, 15, "--compress-tol=") == 0) {
+            opts.compression_tol = atof(arg.substr(15).c_str());
+        } else if (arg == "--model") {
+            opts.model = true;
+        } else if (arg.compare(0, 14, "--model-procs=") == 0) {
+            opts.model = true;
+            opts.model_procs = parse_int_list(arg.substr(14));
+        } else if (arg == "--auto") {
+            opts.auto_select = true;
+        } else if (arg.compare(0, 15, "--mem-per-rank=") == 0) {
+            opts.mem_per_rank_mib = atof(arg.substr(15).c_str());
+        } else if (arg.compare(0, 7, "--json=") == 0) {
+            opts.json_file = arg.substr(7);
+        } else if (arg.compare(0, 12, "--phase-log=") == 0) {
+            opts.phase_log = arg.substr(12);
+        } else if (arg.compare(0, 7, "--size=") == 0) {
+            opts.matrix_size = atoi(arg.substr(7).c_str());
+        } else if (arg.compare(0, 15, "--inverse-size=") == 0) {
+            opts.inverse_size = atoi(arg.substr(15).c_str());
+        } else if (arg.compare(0, 7, "--weak=") == 0) {
+            opts.weak_base = atoi(arg.substr(7).c_str());
+        } else if (arg.compare(0, 13, "--weak-scale=") == 0) {
+            opts.weak_scale = (arg.substr(13) == "memory") ? "memory" : "flops";
+        } else if (arg.compare(0, 15, "--weak-inverse=") == 0) {
+            opts.weak_inverse_base = atoi(arg.substr(15).c_str());
+        } else if (arg.compare(0, 12, "--cache-dir=") == 0) {
+            opts.cache_dir = arg.substr(12);
+        } else if (arg.compare(0, 12, "--cache-mib=") == 0) {
+            opts.cache_mib = atof(arg.substr(12).c_str());
+        } else if (arg == "--cache-write-back") {
+            opts.cache_write_back = true;
+        } else if (arg.compare(0, 15, "--store-layout=") == 0) {
+            opts.store_tiled = (arg.substr(15) == "tiled");
+        } else if (arg.compare(0, 13, "--store-tile=") == 0) {
+            opts.store_tile = max(1, atoi(arg.substr(13).c_str()));
+        } else if (arg.compare(0, 11, "--to-tiled=") == 0) {
+            opts.to_tiled = arg.substr(11);
+        } else if (arg.compare(0, 10, "--to-rows=") == 0) {
+            opts.to_rows = arg.substr(10);
+        } else if (arg.compare(0, 11, "--pipeline=") == 0) {
+            stringstream ss(arg.substr(11));
+            string item;
+            while (getline(ss, item, ',')) {
+                if (!item.empty()) opts.pipeline.push_back(item);
+            }
+        } else if (arg == "--no-prefetch") {
+            opts.prefetch = false;
+        } else if (arg.compare(0, 15, "--prefetch-mib=") == 0) {
+            opts.prefetch_mib = atof(arg.substr(15).c_str());
+        } else if (arg.compare(0, 16, "--weak-baseline=") == 0) {
+            stringstream ss(arg.substr(16));
+            string item;
+            while (getline(ss, item, ',')) {
+                opts.weak_baseline.push_back(atof(item.c_str()));
+            }
+        } else {
+            opts.num_threads = atoi(argv[i]);
         }
     }
+    return opts;
 }
 
-// Matrix multiplication using MPI + OpenMP
-void matrix_multiply_mpi(double* A, double* B, double* C, 
-                         int rank, int size, int n) {
+// ===== Pipeline mode =====
+//
+// --pipeline=<src>[,<src>...] runs one job per stored n x n matrix (a .dat
+// parts prefix or a .tiles file, n from --size): it squares the matrix with
+// the ring multiply and saves the result as "<src>_squared" parts. While job
+// k computes, the operand of job k+1 is prefetched on the I/O thread, so a
+// job only waits for whatever part of its read compute did not hide.
+// --no-prefetch loads each operand when its job starts, for comparison.
+
+void run_pipeline(const RunOptions& opts, int rank, int size) {
+    int n = opts.matrix_size;
+    const vector<string>& jobs = opts.pipeline;
+    int local_rows = block_rows(rank, n / size, size, n);
+    prefetch_init(opts.prefetch_mib);
     
-    int rows_per_proc = n / size;
-    int start_row = rank * rows_per_proc;
-    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+    if (rank == 0) {
+        cout << "=== HPC Matrix Operations System (pipeline) ===" << endl;
+        cout << "MPI Processes: " << size << ", jobs: " << jobs.size()
+             << ", size " << n << "x" << n << endl;
+        cout << "Prefetch: " << (opts.prefetch ? "on" : "off") << " (cap "
+             << fixed << setprecision(1) << g_prefetch.cap / (1024.0 * 1024.0)
+             << " MiB per rank)" << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+        cout << "====================================" << endl;
+    }
     
-    // Local computation with OpenMP
-    #pragma omp parallel for collapse(2)
-    for (int i = start_row; i < end_row; i++) {
-        for (int j = 0; j < n; j++) {
-            double sum = 0.0;
-            for (int k = 0; k < n; k++) {
-                sum += A[i * n + k] * B[k * n + j];
-            }
-            C[i * n + j] = sum;
+    vector<double> X, C((size_t)local_rows * n);
+    double total_wait = 0.0;
+    double start = MPI_Wtime();
+    if (opts.prefetch) prefetch_matrix(jobs[0], n, rank, size);
+    
+    for (size_t k = 0; k < jobs.size(); k++) {
+        double wait_start = MPI_Wtime();
+        int ok = prefetch_take(jobs[k], X, n, rank, size) ? 1 : 0;
+        double wait = MPI_Wtime() - wait_start;
+        if (opts.prefetch && k + 1 < jobs.size()) {
+            prefetch_matrix(jobs[k + 1], n, rank, size);
+        }
+        
+        MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (!ok) {
+            if (rank == 0) cout << "   Job " << k << ": cannot load " << jobs[k] << endl;
+            continue;
+        }
+        
+        double compute_start = MPI_Wtime();
+        matrix_multiply_ring_mpi(X.data(), X.data(), C.data(), rank, size, n);
+        double compute = MPI_Wtime() - compute_start;
+        
+        string output = ends_with(jobs[k], ".tiles") ? jobs[k].substr(0, jobs[k].size() - 6)
+                                                     : jobs[k];
+        save_part(part_file_name(output + "_squared", rank),
+                  reinterpret_cast<const char*>(C.data()), C.size() * sizeof(double));
+        
+        MPI_Allreduce(MPI_IN_PLACE, &wait, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &compute, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        total_wait += wait;
+        if (rank == 0) {
+            cout << "   Job " << k << " (" << jobs[k] << "): load wait " << wait
+                 << " s, compute " << compute << " s" << endl;
         }
     }
     
-    // Gather results
+    prefetch_free();
+    MPI_Barrier(MPI_COMM_WORLD);
+    double elapsed = MPI_Wtime() - start;
     if (rank == 0) {
-        for (int p = 1; p < size; p++) {
-            int p_start = p * rows_per_proc;
-            int p_end = (p == size - 1) ? n : p_start + rows_per_proc;
-            int count = (p_end - p_start) * n;
-            
-            MPI_Recv(&C[p_start * n], count, MPI_DOUBLE, p, 0, 
-                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        }
-    } else {
-        int count = (end_row - start_row) * n;
-        MPI_Send(&C[start_row * n], count, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+        cout << "Pipeline took " << elapsed << " s, " << total_wait
+             << " s of it waiting for operands" << endl;
     }
 }
 
-// Gauss-Jordan elimination for matrix inversion (distributed)
-void matrix_inverse_mpi(double* A, double* A_inv, int rank, int size, int n) {
+// ===== Weak-scaling mode =====
+//
+// --weak=<n1> fixes the work of one rank: what a single rank does at size
+// n1. For P ranks the engine derives
+//   flops-scaled  n = n1 * P^(1/3)   constant 2n^3/P multiply/inverse flops
+//   memory-scaled n = n1 * P^(1/2)   constant n^2/P distributed storage
+// --weak-scale picks the one the multiply runs at. The multiply is the
+// ring variant, so per-rank memory stays O(n^2/P) and memory-scaled sizes
+// grow past what one rank could hold. The inverse replicates its matrices
+// (O(n^2) per rank), so it is always flop-scaled from --weak-inverse.
+// Efficiency is reported against --weak-baseline (the P=1 times),
+// normalised by the actual flops per rank since derived sizes are rounded.
+
+int weak_scaled_size(int base, int size, double exponent) {
+    return max(1, (int)floor(base * pow((double)size, exponent) + 0.5));
+}
+
+static double weak_efficiency(double baseline, int base, int n, int size, double time) {
+    if (baseline <= 0.0 || time <= 0.0) return -1.0;
+    double work_ratio = pow((double)n / base, 3.0) / size;
+    return baseline * work_ratio / time;
+}
+
+int run_weak_scaling(const RunOptions& opts, int rank, int size) {
+    int n_flops = weak_scaled_size(opts.weak_base, size, 1.0 / 3.0);
+    int n_memory = weak_scaled_size(opts.weak_base, size, 0.5);
+    int n = (opts.weak_scale == "memory") ? n_memory : n_flops;
+    int inv_n = weak_scaled_size(opts.weak_inverse_base, size, 1.0 / 3.0);
+    double mult_baseline = (opts.weak_baseline.size() > 0) ? opts.weak_baseline[0] : -1.0;
+    double inv_baseline = (opts.weak_baseline.size() > 1) ? opts.weak_baseline[1] : -1.0;
     
-    // Copy A to working matrix
-    double* work = new double[n * n];
-    #pragma omp parallel for
-    for (int i = 0; i < n * n; i++) {
-        work[i] = A[i];
+    int local_rows = block_rows(rank, n / size, size, n);
+    double local_mib = 3.0 * local_rows * (double)n * sizeof(double) / (1024.0 * 1024.0);
+    
+    if (rank == 0) {
+        cout << "=== HPC Matrix Operations System (weak scaling) ===" << endl;
+        cout << "MPI Processes: " << size << endl;
+        cout << "OpenMP Threads per Process: " << opts.num_threads << endl;
+        cout << "Per-rank work: size " << opts.weak_base << " on one rank ("
+             << opts.weak_scale << "-scaled)" << endl;
+        cout << "Derived sizes: flops-scaled " << n_flops << ", memory-scaled " << n_memory
+             << ", inverse " << inv_n << endl;
+        cout << "Multiply storage per rank: " << fixed << setprecision(1) << local_mib
+             << " MiB" << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+        cout << "====================================" << endl;
     }
     
-    initialize_identity(A_inv, n);
+    vector<double> A_local((size_t)local_rows * n), B_local((size_t)local_rows * n);
+    vector<double> C_local((size_t)local_rows * n);
+    initialize_matrix(A_local.data(), local_rows, n);
+    initialize_matrix(B_local.data(), local_rows, n);
     
-    // Distribute rows among processors
-    int rows_per_proc = n / size;
+    MPI_Barrier(MPI_COMM_WORLD);
     
-    for (int col = 0; col < n; col++) {
-        // Find pivot
-        int pivot_row = col;
-        double max_val = fabs(work[col * n + col]);
-        
-        for (int i = col + 1; i < n; i++) {
-            if (fabs(work[i * n + col]) > max_val) {
-                max_val = fabs(work[i * n + col]);
-                pivot_row = i;
-            }
-        }
-        
-        // Swap rows if needed
-        if (pivot_row != col) {
-            for (int j = 0; j < n; j++) {
-                swap(work[col * n + j], work[pivot_row * n + j]);
-                swap(A_inv[col * n + j], A_inv[pivot_row * n + j]);
-            }
+    if (rank == 0) {
+        cout << "\n[1] Starting Matrix Multiplication (" << n << "x" << n << ", ring)..." << endl;
+    }
+    ResourceMonitor mult_monitor("Weak_Matrix_Multiplication");
+    matrix_multiply_ring_mpi(A_local.data(), B_local.data(), C_local.data(), rank, size, n);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double mult_time = mult_monitor.stop();
+    double mult_eff = weak_efficiency(mult_baseline, opts.weak_base, n, size, mult_time);
+    
+    if (rank == 0) {
+        cout << "   Completed in " << mult_time << " seconds" << endl;
+        cout << "   Per-rank rate: " << 2.0 * n * (double)n * n / size / mult_time / 1e9
+             << " GFLOP/s" << endl;
+        if (mult_eff >= 0.0) {
+            cout << "   Weak-scaling efficiency: " << mult_eff * 100.0 << "%" << endl;
         }
-        
-        // Scale pivot row
-        double pivot = work[col * n + col];
-        if (fabs(pivot) < 1e-10) {
-            cout << "Matrix is singular!" << endl;
-            delete[] work;
-            return;
+        mult_monitor.log_metrics(rank, size, mult_time, "results/performance_log.csv", n);
+    }
+    
+    if (rank == 0) {
+        cout << "\n[2] Starting Matrix Inversion (" << inv_n << "x" << inv_n << ")..." << endl;
+    }
+    vector<double> A_small((size_t)inv_n * inv_n), A_small_inv((size_t)inv_n * inv_n);
+    initialize_matrix(A_small.data(), inv_n, inv_n);
+    
+    ResourceMonitor inv_monitor("Weak_Matrix_Inversion");
+    if (!matrix_inverse_mpi(A_small.data(), A_small_inv.data(), rank, size, inv_n, opts.output) &&
+        rank == 0) {
+        cout << "Matrix is singular!" << endl;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    double inv_time = inv_monitor.stop();
+    double inv_eff = weak_efficiency(inv_baseline, opts.weak_inverse_base, inv_n, size, inv_time);
+    
+    if (rank == 0) {
+        cout << "   Completed in " << inv_time << " seconds" << endl;
+        if (inv_eff >= 0.0) {
+            cout << "   Weak-scaling efficiency: " << inv_eff * 100.0 << "%" << endl;
         }
+        inv_monitor.log_metrics(rank, size, inv_time, "results/performance_log.csv", inv_n);
         
-        #pragma omp parallel for
-        for (int j = 0; j < n; j++) {
-            work[col * n + j] /= pivot;
-            A_inv[col * n + j] /= pivot;
+        if (!opts.json_file.empty()) {
+            RunSummary summary;
+            summary.procs = size;
+            summary.threads = opts.num_threads;
+            summary.matrix_size = n;
+            summary.inverse_size = inv_n;
+            summary.multiply_time = mult_time;
+            summary.inverse_time = inv_time;
+            summary.weak = true;
+            summary.weak_base = opts.weak_base;
+            summary.weak_scale = opts.weak_scale;
+            summary.flops_scaled_size = n_flops;
+            summary.memory_scaled_size = n_memory;
+            summary.multiply_efficiency = mult_eff;
+            summary.inverse_efficiency = inv_eff;
+            write_run_json(summary, opts.json_file);
         }
-        
-        // Eliminate column (distributed among processes)
-        int start_row = rank * rows_per_proc;
-        int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
-        
-        #pragma omp parallel for
-        for (int i = start_row; i < end_row; i++) {
-            if (i != col) {
-                double factor = work[i * n + col];
-                for (int j = 0; j < n; j++) {
-                    work[i * n + j] -= factor * work[col * n + j];
-                    A_inv[i * n + j] -= factor * A_inv[col * n + j];
-                }
+    }
+    return 0;
+}
+
+// ===== Kronecker check mode =====
+//
+// --kron=<m>,<n> checks the implicit Kronecker operations against the
+// explicitly formed product: kron_matmat_mpi and kron_matvec_mpi on an
+// m x (m+1) and an n x (n+2) factor, kron_solve_mpi on square diagonally
+// dominant factors, and that kron_solve_mpi rejects a singular factor. The
+// explicit product has (m n)^2 entries, so this is for small factors.
+// Factors are generated deterministically, identical on every rank.
+
+static double kron_test_entry(int matrix, int i, int j) {
+    return sin(0.37 * (i + 1) + 1.13 * (j + 1) + 0.71 * matrix);
+}
+
+// (A kron B), (p r) x (q s) row-major
+static vector<double> kron_explicit(const double* A, int p, int q,
+                                    const double* B, int r, int s) {
+    vector<double> K((size_t)p * r * q * s);
+    for (int i = 0; i < p; i++)
+        for (int k = 0; k < r; k++)
+            for (int j = 0; j < q; j++)
+                for (int l = 0; l < s; l++)
+                    K[((size_t)i * r + k) * q * s + (size_t)j * s + l] = A[i * q + j] * B[k * s + l];
+    return K;
+}
+
+// Largest relative deviation of Y from K * X over num_vecs vectors
+static double kron_max_error(const vector<double>& K, int rows, int cols,
+                             const double* X, const double* Y, int num_vecs) {
+    double err = 0.0;
+    for (int c = 0; c < num_vecs; c++) {
+        for (int i = 0; i < rows; i++) {
+            double ref = 0.0;
+            for (int j = 0; j < cols; j++) {
+                ref += K[(size_t)i * cols + j] * X[(size_t)c * cols + j];
             }
+            err = max(err, fabs(Y[(size_t)c * rows + i] - ref) / max(1.0, fabs(ref)));
         }
-        
-        // Synchronize work and A_inv matrices
-        MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
-                      work, n * rows_per_proc, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
-                      A_inv, n * rows_per_proc, MPI_DOUBLE, MPI_COMM_WORLD);
     }
-    
-    delete[] work;
+    return err;
 }
 
-// Save matrix to distributed storage
-void save_matrix_distributed(double* matrix, int n, const string& filename, 
-                             int rank, int size) {
-    int rows_per_proc = n / size;
-    int start_row = rank * rows_per_proc;
-    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+bool run_kron_check(const RunOptions& opts, int rank, int size) {
+    const int num_vecs = 3;
+    const double tol = 1e-10;
+    int m = opts.kron[0], n = opts.kron[1];
+    int p = m, q = m + 1, r = n, s = n + 2;
     
-    stringstream ss;
-    ss << filename << "_part" << rank << ".dat";
+    vector<double> A((size_t)p * q), B((size_t)r * s), X((size_t)num_vecs * q * s);
+    for (int i = 0; i < p; i++) for (int j = 0; j < q; j++) A[i * q + j] = kron_test_entry(0, i, j);
+    for (int i = 0; i < r; i++) for (int j = 0; j < s; j++) B[i * s + j] = kron_test_entry(1, i, j);
+    for (size_t x = 0; x < X.size(); x++) X[x] = kron_test_entry(2, (int)x, 0);
     
-    ofstream file(ss.str(), ios::binary);
-    if (file.is_open()) {
-        for (int i = start_row; i < end_row; i++) {
-            file.write(reinterpret_cast<char*>(&matrix[i * n]), n * sizeof(double));
-        }
-        file.close();
+    vector<double> Y((size_t)num_vecs * p * r), y((size_t)p * r);
+    double start = MPI_Wtime();
+    kron_matmat_mpi(A.data(), p, q, B.data(), r, s, X.data(), Y.data(), num_vecs, rank, size);
+    double matmat_time = MPI_Wtime() - start;
+    kron_matvec_mpi(A.data(), p, q, B.data(), r, s, X.data(), y.data(), rank, size);
+    
+    vector<double> K = kron_explicit(A.data(), p, q, B.data(), r, s);
+    double matmat_err = kron_max_error(K, p * r, q * s, X.data(), Y.data(), num_vecs);
+    double matvec_err = kron_max_error(K, p * r, q * s, X.data(), y.data(), 1);
+    
+    // Solve with square factors: the residual K * X - Y must vanish
+    vector<double> A_sq((size_t)m * m), B_sq((size_t)n * n);
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < m; j++) A_sq[i * m + j] = kron_test_entry(3, i, j) + (i == j ? m : 0);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++) B_sq[i * n + j] = kron_test_entry(4, i, j) + (i == j ? n : 0);
+    vector<double> rhs((size_t)num_vecs * m * n), sol(rhs.size());
+    for (size_t x = 0; x < rhs.size(); x++) rhs[x] = kron_test_entry(5, (int)x, 0);
+    
+    start = MPI_Wtime();
+    bool solved = kron_solve_mpi(A_sq.data(), m, B_sq.data(), n, rhs.data(), sol.data(),
+                                 num_vecs, rank, size);
+    double solve_time = MPI_Wtime() - start;
+    vector<double> K_sq = kron_explicit(A_sq.data(), m, m, B_sq.data(), n, n);
+    double solve_err = solved ? kron_max_error(K_sq, m * n, m * n, sol.data(), rhs.data(), num_vecs)
+                              : INFINITY;
+    
+    // A singular factor must be reported, not solved with a partial inverse
+    vector<double> B_singular(B_sq);
+    fill(B_singular.begin(), B_singular.begin() + n, 0.0);
+    bool rejected = !kron_solve_mpi(A_sq.data(), m, B_singular.data(), n, rhs.data(),
+                                    sol.data(), num_vecs, rank, size);
+    
+    bool ok = matmat_err < tol && matvec_err < tol && solve_err < tol && rejected;
+    if (rank == 0) {
+        cout << "=== Kronecker check (A " << p << "x" << q << ", B " << r << "x" << s
+             << ", " << num_vecs << " vectors, " << size << " ranks) ===" << endl;
+        cout << "kron_matmat: max rel error " << matmat_err << " (" << matmat_time << " s) "
+             << (matmat_err < tol ? "PASS" : "FAIL") << endl;
+        cout << "kron_matvec: max rel error " << matvec_err << " "
+             << (matvec_err < tol ? "PASS" : "FAIL") << endl;
+        cout << "kron_solve: max rel residual " << solve_err << " (" << solve_time << " s) "
+             << (solve_err < tol ? "PASS" : "FAIL") << endl;
+        cout << "kron_solve with a singular factor: "
+             << (rejected ? "rejected PASS" : "not detected FAIL") << endl;
     }
+    return ok;
 }
 
-// Load matrix from distributed storage
-void load_matrix_distributed(double* matrix, int n, const string& filename,
-                             int rank, int size) {
-    int rows_per_proc = n / size;
-    int start_row = rank * rows_per_proc;
-    int end_row = (rank == size - 1) ? n : start_row + rows_per_proc;
+// ===== Batched GEMM check mode =====
+//
+// --batched=<n>,<count> runs both batch layouts (a strided batch with
+// padding between entries, and a pointer array of separate buffers)
+// through the MPI batched GEMM and compares every entry on rank 0 against
+// gemm_generic. The requested size runs with <count> entries; each
+// specialized size (4, 8, 16, 32, 64) also runs with a short batch that
+// covers full SIMD groups, a remainder and an uneven split over ranks.
+// Each layout runs once untimed and then three timed times.
+
+// Check one size; prints a line on rank 0 and returns whether it matched
+static bool batched_check_size(int n, long count, int rank, int size) {
+    const double tol = 1e-12;
+    long entry = (long)n * n;
+    long stride = entry + 3;    // Padding makes the C gather use the strided type
     
-    stringstream ss;
-    ss << filename << "_part" << rank << ".dat";
+    vector<double> A(count * stride), B(count * stride), C(count * stride, 0.0);
+    for (long x = 0; x < count * stride; x++) {
+        A[x] = sin(0.37 * x);
+        B[x] = cos(0.53 * x);
+    }
+    vector<vector<double> > C_entries(count, vector<double>(entry, 0.0));
+    vector<const double*> A_ptrs(count), B_ptrs(count);
+    vector<double*> C_ptrs(count);
+    for (long e = 0; e < count; e++) {
+        A_ptrs[e] = &A[e * stride];
+        B_ptrs[e] = &B[e * stride];
+        C_ptrs[e] = C_entries[e].data();
+    }
     
-    ifstream file(ss.str(), ios::binary);
-    if (file.is_open()) {
-        for (int i = start_row; i < end_row; i++) {
-            file.read(reinterpret_cast<char*>(&matrix[i * n]), n * sizeof(double));
+    // The first run of each layout builds (and for the strided layout caches)
+    // its gather type; the best of the following runs is reported
+    const int reps = 3;
+    double strided_time = 0.0, pointer_time = 0.0;
+    for (int r = 0; r <= reps; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        batched_gemm_strided_mpi(A.data(), stride, B.data(), stride, C.data(), stride,
+                                 n, count, rank, size);
+        double elapsed = MPI_Wtime() - start;
+        if (r == 1 || (r > 1 && elapsed < strided_time)) strided_time = elapsed;
+    }
+    for (int r = 0; r <= reps; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        batched_gemm_pointers_mpi(A_ptrs.data(), B_ptrs.data(), C_ptrs.data(),
+                                  n, count, rank, size);
+        double elapsed = MPI_Wtime() - start;
+        if (r == 1 || (r > 1 && elapsed < pointer_time)) pointer_time = elapsed;
+    }
+    
+    if (rank != 0) return true;
+    double err = 0.0;
+    vector<double> ref(entry);
+    for (long e = 0; e < count; e++) {
+        gemm_generic(&A[e * stride], &B[e * stride], ref.data(), n);
+        for (long x = 0; x < entry; x++) {
+            double scale = max(1.0, fabs(ref[x]));
+            err = max(err, fabs(C[e * stride + x] - ref[x]) / scale);
+            err = max(err, fabs(C_entries[e][x] - ref[x]) / scale);
         }
-        file.close();
     }
+    double flops = 2.0 * n * n * n * count;
+    cout << "n=" << setw(3) << n << " count=" << setw(8) << count
+         << "  strided " << setw(9) << flops / strided_time * 1e-9 << " GFLOP/s"
+         << "  pointers " << setw(9) << flops / pointer_time * 1e-9 << " GFLOP/s"
+         << "  max rel error " << err << (err < tol ? "  PASS" : "  FAIL") << endl;
+    return err < tol;
 }
 
-// Analyze communication bottleneck
-void analyze_communication(int rank, int size, double comp_time, 
-                          double comm_time, const string& filename) {
-    double total_comp_time, total_comm_time;
-    
-    MPI_Reduce(&comp_time, &total_comp_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&comm_time, &total_comm_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+bool run_batched_check(const RunOptions& opts, int rank, int size) {
+    const int specialized[] = {4, 8, 16, 32, 64};
+    const long short_batch = 4 * BATCH_SIMD_WIDTH + 3;
     
     if (rank == 0) {
-        double avg_comp = total_comp_time / size;
-        double avg_comm = total_comm_time / size;
-        double comm_ratio = (avg_comm / (avg_comp + avg_comm)) * 100;
-        
-        ofstream logfile(filename, ios::app);
-        logfile << "Processors: " << size << endl;
-        logfile << "Avg Computation Time: " << avg_comp << " seconds" << endl;
-        logfile << "Avg Communication Time: " << avg_comm << " seconds" << endl;
-        logfile << "Communication Overhead: " << comm_ratio << "%" << endl;
-        logfile << "---" << endl;
-        logfile.close();
+        cout << "=== Batched GEMM check (" << size << " ranks, "
+             << omp_get_max_threads() << " threads each) ===" << endl;
+    }
+    bool ok = true;
+    for (int i = 0; i < 5; i++) {
+        if (specialized[i] != opts.batched[0]) {
+            ok = batched_check_size(specialized[i], short_batch, rank, size) && ok;
+        }
     }
+    ok = batched_check_size(opts.batched[0], opts.batched[1], rank, size) && ok;
+    
+    int all_ok = ok ? 1 : 0;
+    MPI_Bcast(&all_ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return all_ok != 0;
 }
 
 int main(int argc, char** argv) {
@@ -250,33 +4110,177 @@ int main(int argc, char** argv) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     
-    // Set number of OpenMP threads
-    int num_threads = 4;
-    if (argc > 1) {
-        num_threads = atoi(argv[1]);
+    RunOptions opts = parse_options(argc, argv);
+    if (opts.error.empty() && opts.compression != COMPRESS_NONE &&
+        !compression_round_trip_ok(opts.compression_tol)) {
+        opts.error = "compression codec failed its round-trip check";
+    }
+    if (!opts.error.empty()) {
+        if (rank == 0) cerr << "Error: " << opts.error << endl;
+        MPI_Finalize();
+        return 1;
     }
+    topology_init(opts.hierarchical);
+    compression_configure(opts.compression, opts.compression_tol);
+    if (!opts.cache_dir.empty()) {
+        cache_init(opts.cache_dir, opts.cache_mib, opts.cache_write_back, rank);
+    }
+    if (!opts.phase_log.empty()) {
+        phase_log_open(opts.phase_log, rank);
+    }
+    
+    // Set number of OpenMP threads
+    int num_threads = opts.num_threads;
     omp_set_num_threads(num_threads);
     
     srand(time(NULL) + rank);
     
+    // ===== MODEL MODE =====
+    // Calibrate, predict and exit without running the full-size workloads
+    if (opts.model) {
+        MachineParams machine = calibrate_machine(rank, size);
+        vector<int> procs = opts.model_procs;
+        if (procs.empty()) {
+            for (int p = 1; p <= max(size, 16); p *= 2) procs.push_back(p);
+        }
+        bool saved = true;
+        if (rank == 0) {
+            vector<ModelPrediction> preds = predict_all(machine, opts.matrix_size,
+                                                        opts.inverse_size, procs);
+            saved = make_directories("results");
+            if (saved) {
+                save_machine_params(machine, MACHINE_PARAMS_FILE);
+                write_model_json(machine, preds, size, num_threads, "results/model_predictions.json");
+            } else {
+                cerr << "Cannot create results/: " << strerror(errno) << endl;
+            }
+            
+            cout << "=== Performance Model ===" << endl;
+            cout << scientific << setprecision(3);
+            cout << "alpha: " << machine.alpha << " s, beta: " << machine.beta << " s/B"
+                 << (machine.comm_calibrated ? "" : " (defaults, single rank)") << endl;
+            cout << "allgather alpha: " << machine.coll_alpha << " s, beta: "
+                 << machine.coll_beta << " s/B" << endl;
+            cout << "flop rate: " << machine.flop_rate << " flop/s, bandwidth: "
+                 << machine.mem_bandwidth << " B/s (cache " << machine.cache_bandwidth
+                 << " B/s)" << endl;
+            cout << fixed << setprecision(4);
+            for (size_t i = 0; i < preds.size(); i++) {
+                cout << setw(24) << left << preds[i].algorithm << right
+                     << " n=" << setw(5) << preds[i].n << " P=" << setw(3) << preds[i].procs
+                     << "  predicted " << setw(10) << preds[i].total_time << " s"
+                     << " (compute " << preds[i].compute_time
+                     << ", comm " << preds[i].comm_time << ")" << endl;
+            }
+            if (saved) cout << "Predictions saved to results/model_predictions.json" << endl;
+        }
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return saved ? 0 : 1;
+    }
+    
+    if (opts.auto_select) {
+        if (rank == 0 && !make_directories("results")) {
+            cerr << "Cannot create results/ (" << strerror(errno)
+                 << "), dispatch decisions will not be logged" << endl;
+        }
+        dispatcher_init(rank, size, opts.mem_per_rank_mib, opts.explicit_compression);
+    }
+    
+    if (opts.weak_base > 0) {
+        run_weak_scaling(opts, rank, size);
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return 0;
+    }
+    
+    if (!opts.batched.empty()) {
+        bool ok = run_batched_check(opts, rank, size);
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    
+    if (!opts.kron.empty()) {
+        bool ok = run_kron_check(opts, rank, size);
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    
+    if (!opts.pipeline.empty()) {
+        run_pipeline(opts, rank, size);
+        bool drained = storage_cache_drain();
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return drained ? 0 : 1;
+    }
+    
+    // ===== LAYOUT CONVERSION MODE =====
+    if (!opts.to_tiled.empty() || !opts.to_rows.empty()) {
+        bool ok = true;
+        string target;
+        if (!opts.to_tiled.empty()) {
+            target = opts.to_tiled + ".tiles";
+            ok = convert_parts_to_tiled(opts.to_tiled, target, opts.matrix_size, rank, size,
+                                        opts.store_tile);
+        } else {
+            target = opts.to_rows;
+            if (target.size() > 6 && target.compare(target.size() - 6, 6, ".tiles") == 0) {
+                target = target.substr(0, target.size() - 6);
+            }
+            ok = convert_tiled_to_parts(opts.to_rows, target, opts.matrix_size, rank, size);
+        }
+        bool drained = storage_cache_drain();
+        int all_ok = ok ? 1 : 0;
+        MPI_Allreduce(MPI_IN_PLACE, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        int all_drained = drained ? 1 : 0;
+        MPI_Allreduce(MPI_IN_PLACE, &all_drained, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        all_ok = all_ok && all_drained;
+        if (rank == 0) {
+            cout << (all_ok ? "Converted to " + target
+                            : all_drained ? "Conversion failed (missing part, size or format mismatch)"
+                                          : "Conversion failed (write-back to shared storage)")
+                 << endl;
+        }
+        datatype_cache_free();
+        topology_free();
+        phase_log_close();
+        MPI_Finalize();
+        return all_ok ? 0 : 1;
+    }
+    
     // Allocate matrices
-    double* A = new double[MATRIX_SIZE * MATRIX_SIZE];
-    double* B = new double[MATRIX_SIZE * MATRIX_SIZE];
-    double* C = new double[MATRIX_SIZE * MATRIX_SIZE];
-    double* A_inv = new double[MATRIX_SIZE * MATRIX_SIZE];
+    int n = opts.matrix_size;
+    double* A = new double[(size_t)n * n];
+    double* B = new double[(size_t)n * n];
+    double* C = new double[(size_t)n * n];
+    double* A_inv = new double[(size_t)n * n];
     
     if (rank == 0) {
         cout << "=== HPC Matrix Operations System ===" << endl;
-        cout << "Matrix Size: " << MATRIX_SIZE << "x" << MATRIX_SIZE << endl;
+        cout << "Matrix Size: " << n << "x" << n << endl;
         cout << "MPI Processes: " << size << endl;
         cout << "OpenMP Threads per Process: " << num_threads << endl;
         cout << "Total Parallel Units: " << size * num_threads << endl;
+        cout << "Nodes: " << g_topology.num_nodes
+             << (g_topology.hierarchical ? " (hierarchical collectives)" : "") << endl;
         cout << "====================================" << endl;
     }
     
     // Initialize matrices
-    initialize_matrix(A, MATRIX_SIZE, MATRIX_SIZE);
-    initialize_matrix(B, MATRIX_SIZE, MATRIX_SIZE);
+    initialize_matrix(A, n, n);
+    initialize_matrix(B, n, n);
     
     MPI_Barrier(MPI_COMM_WORLD);
     
@@ -288,7 +4292,18 @@ int main(int argc, char** argv) {
     ResourceMonitor mult_monitor("Matrix_Multiplication");
     double mult_start = MPI_Wtime();
     
-    matrix_multiply_mpi(A, B, C, rank, size, MATRIX_SIZE);
+    AbftReport abft_report = AbftReport();
+    if (opts.abft && opts.auto_select) {
+        abft_report = matrix_multiply_abft_auto_mpi(A, B, C, rank, size, n,
+                                                    opts.abft_opts, opts.output);
+    } else if (opts.abft) {
+        abft_report = matrix_multiply_abft_mpi(A, B, C, rank, size, n,
+                                               opts.abft_opts, opts.output);
+    } else if (opts.auto_select) {
+        matrix_multiply_auto_mpi(A, B, C, rank, size, n, opts.output);
+    } else {
+        matrix_multiply_mpi(A, B, C, rank, size, n, opts.output);
+    }
     
     MPI_Barrier(MPI_COMM_WORLD);
     double mult_time = mult_monitor.stop();
@@ -296,12 +4311,44 @@ int main(int argc, char** argv) {
     
     if (rank == 0) {
         cout << "   Completed in " << mult_time << " seconds" << endl;
+        if (opts.abft) {
+            cout << "   ABFT: " << abft_report.tiles_checked << " tiles checked, "
+                 << abft_report.tiles_corrupted << " corrupted, "
+                 << abft_report.elements_corrected << " elements corrected, "
+                 << abft_report.tiles_recomputed << " tiles recomputed" << endl;
+        }
         mult_monitor.log_metrics(rank, size, mult_time, 
-                                "results/performance_log.csv");
+                                "results/performance_log.csv", n);
+    }
+    
+    // ===== LOW-PRECISION MULTIPLICATION =====
+    if (opts.low_precision != LOWP_NONE) {
+        if (rank == 0) {
+            cout << "\n[1b] Starting " << low_precision_name(opts.low_precision)
+                 << " Matrix Multiplication..." << endl;
+        }
+        
+        ResourceMonitor lowp_monitor(string("Matrix_Multiplication_") +
+                                     low_precision_name(opts.low_precision));
+        double lowp_error = matrix_multiply_low_precision_mpi(A, B, C, opts.low_precision,
+                                                              rank, size, n);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double lowp_time = lowp_monitor.stop();
+        
+        if (rank == 0) {
+            cout << "   Completed in " << lowp_time << " seconds (relative error vs double: "
+                 << lowp_error << ")" << endl;
+            lowp_monitor.log_metrics(rank, size, lowp_time,
+                                     "results/performance_log.csv", n);
+        }
     }
     
     // Save result to distributed storage
-    save_matrix_distributed(C, MATRIX_SIZE, "data/matrix_C", rank, size);
+    if (opts.store_tiled) {
+        save_matrix_tiled(C, n, "data/matrix_C.tiles", rank, size, opts.store_tile);
+    } else {
+        save_matrix_distributed(C, n, "data/matrix_C", rank, size);
+    }
     
     MPI_Barrier(MPI_COMM_WORLD);
     
@@ -311,7 +4358,7 @@ int main(int argc, char** argv) {
     }
     
     // Use a smaller test matrix for inversion (512x512) due to computational cost
-    int inv_size = 512;
+    int inv_size = opts.inverse_size;
     double* A_small = new double[inv_size * inv_size];
     double* A_small_inv = new double[inv_size * inv_size];
     
@@ -320,7 +4367,12 @@ int main(int argc, char** argv) {
     ResourceMonitor inv_monitor("Matrix_Inversion");
     double inv_start = MPI_Wtime();
     
-    matrix_inverse_mpi(A_small, A_small_inv, rank, size, inv_size);
+    if (opts.auto_select) {
+        matrix_inverse_auto_mpi(A_small, A_small_inv, rank, size, inv_size, opts.output);
+    } else if (!matrix_inverse_mpi(A_small, A_small_inv, rank, size, inv_size, opts.output) &&
+               rank == 0) {
+        cout << "Matrix is singular!" << endl;
+    }
     
     MPI_Barrier(MPI_COMM_WORLD);
     double inv_time = inv_monitor.stop();
@@ -329,7 +4381,56 @@ int main(int argc, char** argv) {
     if (rank == 0) {
         cout << "   Completed in " << inv_time << " seconds" << endl;
         inv_monitor.log_metrics(rank, size, inv_time, 
-                               "results/performance_log.csv");
+                               "results/performance_log.csv", inv_size);
+    }
+    
+    // ===== LOG-DETERMINANT =====
+    double det_time = -1.0;
+    if (opts.logdet) {
+        if (rank == 0) {
+            cout << "\n[3] Starting Log-Determinant (" << (opts.spd ? "Cholesky" : "LU")
+                 << ")..." << endl;
+        }
+        
+        // --spd: factor the SPD matrix A * A^T / n + I built from rank 0's
+        // test matrix (each rank seeds its own A, so rank 0's is broadcast)
+        vector<double> spd_matrix;
+        const double* det_input = A_small;
+        if (opts.spd) {
+            spd_matrix.assign((size_t)inv_size * inv_size, 0.0);
+            #pragma omp parallel for
+            for (int i = 0; i < (rank == 0 ? inv_size : 0); i++) {
+                for (int j = 0; j < inv_size; j++) {
+                    double sum = 0.0;
+                    for (int k = 0; k < inv_size; k++) {
+                        sum += A_small[i * inv_size + k] * A_small[j * inv_size + k];
+                    }
+                    spd_matrix[(size_t)i * inv_size + j] = sum / inv_size + (i == j ? 1.0 : 0.0);
+                }
+            }
+            MPI_Bcast(spd_matrix.data(), inv_size * inv_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+            det_input = spd_matrix.data();
+        }
+        
+        ResourceMonitor det_monitor("Log_Determinant");
+        LogDeterminant ld = log_determinant_mpi(det_input, rank, size, inv_size, opts.spd);
+        MPI_Barrier(MPI_COMM_WORLD);
+        det_time = det_monitor.stop();
+        
+        // Cholesky result checked against the LU path on the same matrix
+        LogDeterminant ld_lu = opts.spd ? log_determinant_mpi(det_input, rank, size, inv_size)
+                                        : ld;
+        
+        if (rank == 0) {
+            cout << "   sign = " << ld.sign << ", log|det| = " << ld.log_abs
+                 << ", det = " << determinant(ld) << " (" << det_time << " s)" << endl;
+            if (opts.spd) {
+                cout << "   LU check: sign = " << ld_lu.sign << ", log|det| = " << ld_lu.log_abs
+                     << " (difference " << fabs(ld.log_abs - ld_lu.log_abs) << ")" << endl;
+            }
+            det_monitor.log_metrics(rank, size, det_time,
+                                    "results/performance_log.csv", inv_size);
+        }
     }
     
     // Analyze communication bottleneck
@@ -344,6 +4445,19 @@ int main(int argc, char** argv) {
         cout << "Results saved to distributed storage" << endl;
         cout << "Performance logs: results/performance_log.csv" << endl;
         cout << "Bottleneck analysis: results/bottleneck_analysis.txt" << endl;
+        
+        if (!opts.json_file.empty()) {
+            RunSummary summary;
+            summary.procs = size;
+            summary.threads = num_threads;
+            summary.matrix_size = n;
+            summary.inverse_size = inv_size;
+            summary.multiply_time = mult_time;
+            summary.multiply_comm = mult_comm;
+            summary.inverse_time = inv_time;
+            summary.logdet_time = det_time;
+            write_run_json(summary, opts.json_file);
+        }
     }
     
     // Cleanup
@@ -354,6 +4468,10 @@ int main(int argc, char** argv) {
     delete[] A_small;
     delete[] A_small_inv;
     
+    bool drained = storage_cache_drain();
+    datatype_cache_free();
+    topology_free();
+    phase_log_close();
     MPI_Finalize();
-    return 0;
+    return drained ? 0 : 1;
 }
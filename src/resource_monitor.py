@@ -8,215 +8,701 @@ import psutil
 import time
 import json
 import os
+import math
+import socket
 from datetime import datetime
-from threading import Thread
+from threading import Thread, Event
 import csv
+import numpy as np
 
-class ResourceMonitor:
-    """Comprehensive resource monitoring for HPC operations"""
+
+CSV_CHUNK_ROWS = 65536
+
+
+class MetricRing:
+    """
+    Preallocated ring buffer of samples for one metric
+
+    Samples are written in place into a structured numpy array, so sampling
+    allocates nothing per row. flush() appends the rows not yet on disk to an
+    append-only binary log (raw records; the dtype lives in a JSON sidecar),
+    which keeps memory bounded however long the run is. Running sum/min/max
+    of the summary fields are updated on append.
+    """
+
+    def __init__(self, name, dtype, rate, capacity, summary_fields=()):
+        self.name = name
+        self.dtype = np.dtype(dtype)
+        self.rate = rate
+        self.capacity = capacity
+        self.buffer = np.zeros(capacity, dtype=self.dtype)
+        self.count = 0       # Rows appended since start
+        self.flushed = 0     # Rows already in the log
+        self.dropped = 0     # Rows overwritten before they were flushed
+        self.last = None
+        self.path = None
+        self.log = None
+        self.stats = {f: [0.0, math.inf, -math.inf] for f in summary_fields}
+        self._stat_index = [(self.dtype.names.index(f), self.stats[f]) for f in summary_fields]
+
+    def open(self, path, start_time):
+        """Start a new binary log at path (sidecar: path + '.json')"""
+        self.path = path
+        header = {
+            'metric': self.name,
+            'dtype': self.dtype.descr,
+            'rate_hz': self.rate,
+            'start_time': start_time,
+        }
+        with open(path + ".json", 'w') as f:
+            json.dump(header, f, indent=2)
+        self.log = open(path, 'wb')
+
+    def append(self, row):
+        """Store one sample (a tuple in dtype field order)"""
+        if self.count - self.flushed >= self.capacity:
+            # The flush fell a whole ring behind: lose the oldest row
+            self.flushed += 1
+            self.dropped += 1
+        self.buffer[self.count % self.capacity] = row
+        self.count += 1
+        self.last = row
+        for index, stat in self._stat_index:
+            value = row[index]
+            stat[0] += value
+            if value < stat[1]:
+                stat[1] = value
+            if value > stat[2]:
+                stat[2] = value
+
+    def flush(self):
+        """Append unflushed rows to the log"""
+        if self.log is None or self.flushed == self.count:
+            return
+        first = self.flushed % self.capacity
+        last = self.count % self.capacity
+        if first < last:
+            self.buffer[first:last].tofile(self.log)
+        else:
+            self.buffer[first:].tofile(self.log)
+            self.buffer[:last].tofile(self.log)
+        self.log.flush()
+        self.flushed = self.count
+
+    def close(self):
+        self.flush()
+        if self.log is not None:
+            self.log.close()
+            self.log = None
+
+    def recent(self):
+        """Rows still in the ring, oldest first"""
+        held = min(self.count, self.capacity)
+        index = np.arange(self.count - held, self.count) % self.capacity
+        return self.buffer[index]
+
+    def mean(self, field):
+        return self.stats[field][0] / self.count if self.count else 0.0
+
+
+def read_monitor_log(path, mmap=True):
+    """Open a binary monitor log as a structured array (memory-mapped by default)"""
+    with open(path + ".json", 'r') as f:
+        header = json.load(f)
+    dtype = np.dtype([tuple(tuple(x) if isinstance(x, list) else x for x in field)
+                      for field in header['dtype']])
+    rows = os.path.getsize(path) // dtype.itemsize  # Ignore a torn last record
+    if rows == 0:
+        return np.zeros(0, dtype=dtype)
+    if mmap:
+        return np.memmap(path, dtype=dtype, mode='r', shape=(rows,))
+    return np.fromfile(path, dtype=dtype, count=rows)
+
+
+# MPI rank discovery: ranks are the processes under a launcher on this node,
+# minus the launcher's own daemons; the rank number comes from the
+# environment the launcher gives each rank
+MPI_LAUNCHERS = ('mpirun', 'mpiexec', 'orterun', 'prterun')
+MPI_DAEMONS = MPI_LAUNCHERS + ('orted', 'prted', 'hydra_pmi_proxy')
+RANK_ENV = ('OMPI_COMM_WORLD_RANK', 'PMIX_RANK', 'PMI_RANK')
+# Commands that only launch the real rank (`mpirun sh -c ...`, `mpirun numactl ...`)
+RANK_WRAPPERS = ('sh', 'bash', 'dash', 'zsh', 'ksh', 'env', 'time', 'timeout', 'nice',
+                 'stdbuf', 'numactl', 'taskset', 'chrt', 'hwloc-bind')
+
+RANK_FIELDS = [('timestamp', 'f8'), ('rank', 'i4'), ('pid', 'i4'),
+               ('cpu_user', 'f8'), ('cpu_system', 'f8'), ('rss_mb', 'f8'),
+               ('ctx_voluntary', 'i8'), ('ctx_involuntary', 'i8'),
+               ('minor_faults', 'i8'), ('major_faults', 'i8'),
+               ('read_bytes', 'i8'), ('write_bytes', 'i8')]
+# Counters that only grow over a process's life; phases get their deltas
+RANK_COUNTERS = ('cpu_user', 'cpu_system', 'ctx_voluntary', 'ctx_involuntary',
+                 'minor_faults', 'major_faults', 'read_bytes', 'write_bytes')
+
+
+def find_mpi_launchers():
+    """PIDs of the mpirun-style launchers running on this node"""
+    return [proc.info['pid'] for proc in psutil.process_iter(['pid', 'name'])
+            if proc.info['name'] in MPI_LAUNCHERS]
+
+
+def discover_rank_processes(launcher_pids):
+    """
+    {rank: psutil.Process} of the MPI ranks under the given launchers
+
+    Processes a rank forks (helpers, pool workers) inherit its environment
+    and are skipped so each rank is counted once. A wrapper the launcher
+    started (a shell, numactl, ...) is not the rank: the process it runs
+    is. Ranks whose environment cannot be read are numbered after the
+    known ones, in PID order.
+    """
+    candidates = {}
+    for launcher in launcher_pids:
+        try:
+            children = psutil.Process(launcher).children(recursive=True)
+        except psutil.NoSuchProcess:
+            continue
+        for child in children:
+            try:
+                if child.name() in MPI_DAEMONS:
+                    continue
+                ppid = child.ppid()
+                try:
+                    env = child.environ()
+                except psutil.AccessDenied:
+                    env = {}
+            except psutil.NoSuchProcess:
+                continue
+            rank = next((int(env[k]) for k in RANK_ENV if k in env), None)
+            candidates[child.pid] = (rank, ppid, child)
+    
+    parents = {ppid for _, ppid, _ in candidates.values()}
+    
+    def is_wrapper(pid):
+        try:
+            return pid in parents and candidates[pid][2].name() in RANK_WRAPPERS
+        except psutil.NoSuchProcess:
+            return False
+    
+    def forked_by_rank(ppid):
+        while ppid in candidates:
+            if not is_wrapper(ppid):
+                return True
+            ppid = candidates[ppid][1]
+        return False
+    
+    ranks = {}
+    unranked = []
+    for pid, (rank, ppid, proc) in sorted(candidates.items()):
+        if is_wrapper(pid) or forked_by_rank(ppid):
+            continue
+        if rank is None:
+            unranked.append(proc)
+        else:
+            ranks[rank] = proc
+    next_rank = max(ranks) + 1 if ranks else 0
+    for proc in unranked:
+        ranks[next_rank] = proc
+        next_rank += 1
+    return ranks
+
+
+def read_page_faults(pid):
+    """(minor, major) page faults of a process, from /proc/<pid>/stat"""
+    try:
+        with open(f"/proc/{pid}/stat", 'rb') as f:
+            fields = f.read().rsplit(b')', 1)[1].split()
+        return int(fields[7]), int(fields[9])
+    except (OSError, IndexError, ValueError):
+        return 0, 0
+
+
+def read_phase_log(path, start_wall):
+    """
+    Phase windows from the engine's --phase-log markers
+
+    Returns (rank, operation, begin, end) tuples with times relative to the
+    monitor's start; markers from before the monitor started are ignored.
+    """
+    open_phases = {}
+    windows = []
+    if not path or not os.path.exists(path):
+        return windows
+    with open(path, 'r') as f:
+        for line in f:
+            parts = line.split(None, 3)
+            if len(parts) != 4:
+                continue
+            when, rank, event, operation = parts
+            when = float(when) - start_wall
+            key = (int(rank), operation.strip())
+            if event == 'begin':
+                open_phases[key] = when
+            elif event == 'end' and key in open_phases:
+                begin = open_phases.pop(key)
+                if begin >= 0:
+                    windows.append((key[0], key[1], begin, when))
+    return windows
+
+
+def _rank_usage(rows, begin=None, end=None):
+    """
+    Resource use of one rank, over its whole life or within [begin, end]
+
+    A rank that was restarted (or rediscovered) under a new PID has rows
+    for several processes; each one's counters run on their own, so deltas
+    are taken per PID and summed. Whole-life usage is measured from each
+    PID's first sample, like the node's net_io_start/disk_io_start
+    baselines, so it covers the same window as duration_seconds.
+    """
+    t = rows['timestamp']
+    usage = dict.fromkeys(RANK_COUNTERS, 0.0)
+    for pid in np.unique(rows['pid']):
+        proc = rows[rows['pid'] == pid]
+        for field in RANK_COUNTERS:
+            values = proc[field].astype(np.float64)
+            if begin is None:
+                usage[field] += float(values[-1] - values[0])
+            else:
+                # Interpolate between the samples around each end of the phase
+                pt = proc['timestamp']
+                usage[field] += float(np.interp(end, pt, values) - np.interp(begin, pt, values))
+    
+    # RSS of all the rank's processes at each sampling instant
+    times, inverse = np.unique(t, return_inverse=True)
+    rss_at = np.bincount(inverse, weights=rows['rss_mb'], minlength=len(times))
+    if begin is None:
+        rss = rss_at
+        usage['duration_seconds'] = float(t[-1] - t[0])
+    else:
+        inside = (times >= begin) & (times <= end)
+        rss = rss_at[inside] if inside.any() else np.interp([begin, end], times, rss_at)
+        usage['duration_seconds'] = float(end - begin)
+    usage['cpu_seconds'] = usage['cpu_user'] + usage['cpu_system']
+    usage['cpu_percent'] = (100.0 * usage['cpu_seconds'] / usage['duration_seconds']
+                            if usage['duration_seconds'] > 0 else 0.0)
+    usage['peak_rss_mb'] = float(np.max(rss))
+    usage['mean_rss_mb'] = float(np.mean(rss))
+    return usage
+
+
+def _node_usage(per_rank):
+    """Sum per-rank usage into a node total"""
+    node = {}
+    for usage in per_rank.values():
+        for field, value in usage.items():
+            if field in ('duration_seconds', 'cpu_percent', 'mean_rss_mb', 'pid', 'pids'):
+                continue
+            node[field] = node.get(field, 0.0) + value
+    if per_rank:
+        node['duration_seconds'] = max(u['duration_seconds'] for u in per_rank.values())
+        node['ranks'] = len(per_rank)
+    return node
+
+
+def attribute_rank_samples(data, phases=()):
+    """
+    Per-rank and per-node resource use from a ranks log, overall and per phase
+
+    `data` is the structured array of the 'ranks' metric and `phases` the
+    windows from read_phase_log(). A phase that repeats (one window per rank,
+    or the same operation run twice) is summed per rank. The node's overall
+    peak RSS is the largest sum over ranks at one sampling instant; within a
+    phase it is the sum of the ranks' peaks.
+    """
+    result = {'node': socket.gethostname(), 'ranks': {}, 'node_total': {}, 'phases': {}}
+    if len(data) == 0:
+        return result
+    
+    by_rank = {}
+    for rank in np.unique(data['rank']):
+        rows = data[data['rank'] == rank]
+        by_rank[int(rank)] = rows
+        result['ranks'][int(rank)] = dict(_rank_usage(rows), pid=int(rows['pid'][-1]),
+                                          pids=[int(p) for p in np.unique(rows['pid'])])
+    
+    result['node_total'] = _node_usage(result['ranks'])
+    times, inverse = np.unique(data['timestamp'], return_inverse=True)
+    node_rss = np.bincount(inverse, weights=data['rss_mb'], minlength=len(times))
+    result['node_total']['peak_rss_mb'] = float(node_rss.max())
     
-    def __init__(self, log_dir="results/monitoring", interval=0.5):
+    for rank, operation, begin, end in phases:
+        rows = by_rank.get(rank)
+        if rows is None:
+            continue
+        usage = _rank_usage(rows, begin, end)
+        phase = result['phases'].setdefault(operation, {'ranks': {}, 'begin': begin, 'end': end})
+        phase['begin'] = min(phase['begin'], begin)
+        phase['end'] = max(phase['end'], end)
+        if rank in phase['ranks']:
+            previous = phase['ranks'][rank]
+            for field in RANK_COUNTERS + ('cpu_seconds', 'duration_seconds'):
+                previous[field] += usage[field]
+            previous['peak_rss_mb'] = max(previous['peak_rss_mb'], usage['peak_rss_mb'])
+            previous['cpu_percent'] = (100.0 * previous['cpu_seconds'] / previous['duration_seconds']
+                                       if previous['duration_seconds'] > 0 else 0.0)
+        else:
+            phase['ranks'][rank] = usage
+    for phase in result['phases'].values():
+        phase['node_total'] = _node_usage(phase['ranks'])
+    return result
+
+
+class ResourceMonitor:
+    """
+    Comprehensive resource monitoring for HPC operations
+
+    Each metric (cpu, freq, memory, network, disk, ranks) is sampled at its
+    own rate (`rates`, in Hz; default 1/interval, freq at most 1 Hz) into a
+    MetricRing holding `buffer_seconds` of samples. Rings are flushed to
+    <log_dir>/<prefix>_<metric>_<timestamp>.bin every `flush_interval`
+    seconds, so the monitor can run for hours at 10-100 Hz in constant memory.
+    save_logs() converts the binary logs to the CSV files the plots read.
+
+    System-wide numbers include other tenants of the node. The 'ranks'
+    metric samples only our job: the processes under mpirun on this node
+    (or under `launcher_pid`), rediscovered every `discover_interval`
+    seconds. With `phase_log` (the engine's --phase-log file) the summary
+    attributes each rank's usage to the engine's phases.
+    """
+
+    METRICS = ('cpu', 'freq', 'memory', 'network', 'disk', 'ranks')
+
+    def __init__(self, log_dir="results/monitoring", interval=0.5, rates=None,
+                 flush_interval=5.0, buffer_seconds=30.0, prefix="monitor",
+                 launcher_pid=None, phase_log=None, discover_interval=2.0):
         self.log_dir = log_dir
         self.interval = interval
+        self.flush_interval = flush_interval
+        self.prefix = prefix
+        self.launcher_pid = launcher_pid
+        self.phase_log = phase_log
+        self.discover_interval = discover_interval
+        self.start_wall = None
+        self._launchers = []
+        self._rank_procs = {}
+        self._next_discovery = 0.0
         self.monitoring = False
         self.monitor_thread = None
+        self._stop_event = Event()
+        self.busy_seconds = 0.0   # Time spent sampling and flushing
+        self.elapsed_seconds = 0.0
+        if buffer_seconds <= flush_interval:
+            raise ValueError("buffer_seconds must exceed flush_interval")
         
         # Create log directory
         os.makedirs(log_dir, exist_ok=True)
         
-        # Initialize data storage
-        self.cpu_data = []
-        self.memory_data = []
-        self.network_data = []
-        self.disk_data = []
-        
-        # Get initial network and disk I/O counters
+        self.num_cores = psutil.cpu_count()
         self.net_io_start = psutil.net_io_counters()
         self.disk_io_start = psutil.disk_io_counters()
         
+        rates = dict(rates or {})
+        default_rate = 1.0 / interval
+        metric_rates = {m: rates.get(m, default_rate) for m in self.METRICS}
+        if 'freq' not in rates:
+            metric_rates['freq'] = min(1.0, default_rate)
+        
+        dtypes = {
+            'cpu': [('timestamp', 'f8'), ('cpu_percent_total', 'f8'),
+                    ('cpu_percent_per_core', 'f4', (self.num_cores,)), ('load_avg', 'f4', (3,))],
+            'freq': [('timestamp', 'f8'), ('cpu_freq_current', 'f8')],
+            'memory': [('timestamp', 'f8'), ('total_mb', 'f8'), ('available_mb', 'f8'),
+                       ('used_mb', 'f8'), ('percent', 'f8'), ('swap_total_mb', 'f8'),
+                       ('swap_used_mb', 'f8'), ('swap_percent', 'f8')],
+            'network': [('timestamp', 'f8'), ('bytes_sent', 'i8'), ('bytes_recv', 'i8'),
+                        ('packets_sent', 'i8'), ('packets_recv', 'i8'),
+                        ('errin', 'i8'), ('errout', 'i8')],
+            'disk': [('timestamp', 'f8'), ('read_bytes', 'i8'), ('write_bytes', 'i8'),
+                     ('read_count', 'i8'), ('write_count', 'i8')],
+            'ranks': RANK_FIELDS,
+        }
+        summary_fields = {
+            'cpu': ('cpu_percent_total',),
+            'memory': ('percent', 'used_mb'),
+        }
+        samplers = {
+            'cpu': self._sample_cpu,
+            'freq': self._sample_freq,
+            'memory': self._sample_memory,
+            'network': self._sample_network,
+            'disk': self._sample_disk,
+            'ranks': self._sample_ranks,
+        }
+        
+        # Metrics this host cannot report (no disks in a container, ...) are skipped
+        unavailable = set()
+        if self.net_io_start is None:
+            unavailable.add('network')
+        if self.disk_io_start is None:
+            unavailable.add('disk')
+        if psutil.cpu_freq() is None:
+            unavailable.add('freq')
+        
+        self.rings = {}
+        self.samplers = {}
+        for metric in self.METRICS:
+            rate = metric_rates[metric]
+            if metric in unavailable or rate <= 0:
+                continue
+            capacity = max(16, int(math.ceil(rate * buffer_seconds)))
+            if metric == 'ranks':
+                capacity *= max(8, self.num_cores)  # One row per local rank
+            self.rings[metric] = MetricRing(metric, dtypes[metric], rate, capacity,
+                                            summary_fields.get(metric, ()))
+            self.samplers[metric] = samplers[metric]
+        
     def start(self):
         """Start monitoring in background thread"""
+        timestamp_str = datetime.now().strftime("%Y%m%d_%H%M%S")
+        self._start_perf = time.perf_counter()
+        self.start_wall = time.time()
+        for metric, ring in self.rings.items():
+            ring.open(os.path.join(self.log_dir, f"{self.prefix}_{metric}_{timestamp_str}.bin"),
+                      self.start_wall)
+        psutil.cpu_percent(interval=None, percpu=True)  # The first call only sets the baseline
+        
         self.monitoring = True
+        self._stop_event.clear()
         self.monitor_thread = Thread(target=self._monitor_loop)
         self.monitor_thread.daemon = True
         self.monitor_thread.start()
-        print(f"[Monitor] Started resource monitoring (interval: {self.interval}s)")
+        rates = ", ".join(f"{m} {r.rate:g} Hz" for m, r in self.rings.items())
+        print(f"[Monitor] Started resource monitoring ({rates})")
         
     def stop(self):
         """Stop monitoring"""
         self.monitoring = False
+        self._stop_event.set()
         if self.monitor_thread:
             self.monitor_thread.join()
         print("[Monitor] Stopped resource monitoring")
         
+    def _sample_cpu(self, timestamp):
+        # One /proc/stat read: the total is the mean of the per-core values
+        per_core = psutil.cpu_percent(interval=None, percpu=True)
+        load_avg = os.getloadavg() if hasattr(os, 'getloadavg') else (0, 0, 0)
+        return (timestamp, sum(per_core) / len(per_core), per_core, load_avg)
+    
+    def _sample_freq(self, timestamp):
+        cpu_freq = psutil.cpu_freq()
+        return (timestamp, cpu_freq.current if cpu_freq else 0)
+    
+    def _sample_memory(self, timestamp):
+        mem = psutil.virtual_memory()
+        swap = psutil.swap_memory()
+        return (timestamp, mem.total / (1024**2), mem.available / (1024**2),
+                mem.used / (1024**2), mem.percent, swap.total / (1024**2),
+                swap.used / (1024**2), swap.percent)
+    
+    def _sample_network(self, timestamp):
+        net_io = psutil.net_io_counters()
+        start = self.net_io_start
+        return (timestamp, net_io.bytes_sent - start.bytes_sent,
+                net_io.bytes_recv - start.bytes_recv,
+                net_io.packets_sent - start.packets_sent,
+                net_io.packets_recv - start.packets_recv,
+                net_io.errin, net_io.errout)
+    
+    def _sample_disk(self, timestamp):
+        disk_io = psutil.disk_io_counters()
+        start = self.disk_io_start
+        return (timestamp, disk_io.read_bytes - start.read_bytes,
+                disk_io.write_bytes - start.write_bytes,
+                disk_io.read_count - start.read_count,
+                disk_io.write_count - start.write_count)
+    
+    def _sample_ranks(self, timestamp):
+        # Appends one row per rank itself; returns None
+        if timestamp >= self._next_discovery:
+            if self.launcher_pid is not None:
+                self._launchers = [self.launcher_pid]
+            elif not any(psutil.pid_exists(pid) for pid in self._launchers):
+                self._launchers = find_mpi_launchers()
+            self._rank_procs = discover_rank_processes(self._launchers)
+            self._next_discovery = timestamp + self.discover_interval
+        
+        ring = self.rings['ranks']
+        for rank, proc in list(self._rank_procs.items()):
+            try:
+                with proc.oneshot():
+                    cpu = proc.cpu_times()
+                    rss = proc.memory_info().rss
+                    ctx = proc.num_ctx_switches()
+                    try:
+                        io = proc.io_counters()
+                        io = (io.read_bytes, io.write_bytes)
+                    except (psutil.AccessDenied, AttributeError):
+                        io = (0, 0)
+            except (psutil.NoSuchProcess, psutil.AccessDenied):
+                del self._rank_procs[rank]
+                continue
+            minor, major = read_page_faults(proc.pid)
+            ring.append((timestamp, rank, proc.pid, cpu.user, cpu.system, rss / (1024**2),
+                         ctx.voluntary, ctx.involuntary, minor, major, io[0], io[1]))
+        return None
+    
     def _monitor_loop(self):
-        """Main monitoring loop"""
-        start_time = time.time()
+        """Sample each metric when it is due; flush the rings periodically"""
+        start = self._start_perf
+        next_due = {metric: start for metric in self.rings}
+        next_flush = start + self.flush_interval
         
-        while self.monitoring:
-            timestamp = time.time() - start_time
-            
-            # CPU monitoring
-            cpu_percent = psutil.cpu_percent(interval=None, percpu=True)
-            cpu_freq = psutil.cpu_freq()
-            
-            self.cpu_data.append({
-                'timestamp': timestamp,
-                'cpu_percent_total': psutil.cpu_percent(interval=None),
-                'cpu_percent_per_core': cpu_percent,
-                'cpu_freq_current': cpu_freq.current if cpu_freq else 0,
-                'num_cores': psutil.cpu_count(),
-                'load_avg': os.getloadavg() if hasattr(os, 'getloadavg') else [0, 0, 0]
-            })
-            
-            # Memory monitoring
-            mem = psutil.virtual_memory()
-            swap = psutil.swap_memory()
-            
-            self.memory_data.append({
-                'timestamp': timestamp,
-                'total_mb': mem.total / (1024**2),
-                'available_mb': mem.available / (1024**2),
-                'used_mb': mem.used / (1024**2),
-                'percent': mem.percent,
-                'swap_total_mb': swap.total / (1024**2),
-                'swap_used_mb': swap.used / (1024**2),
-                'swap_percent': swap.percent
-            })
+        while not self._stop_event.is_set():
+            now = time.perf_counter()
+            for metric, ring in self.rings.items():
+                if now < next_due[metric]:
+                    continue
+                row = self.samplers[metric](now - start)
+                if row is not None:
+                    ring.append(row)
+                period = 1.0 / ring.rate
+                next_due[metric] += period
+                if next_due[metric] < now:
+                    next_due[metric] = now + period  # Skip missed slots instead of bursting
+            if now >= next_flush:
+                for ring in self.rings.values():
+                    ring.flush()
+                next_flush = now + self.flush_interval
             
-            # Network monitoring
-            net_io = psutil.net_io_counters()
-            
-            self.network_data.append({
-                'timestamp': timestamp,
-                'bytes_sent': net_io.bytes_sent - self.net_io_start.bytes_sent,
-                'bytes_recv': net_io.bytes_recv - self.net_io_start.bytes_recv,
-                'packets_sent': net_io.packets_sent - self.net_io_start.packets_sent,
-                'packets_recv': net_io.packets_recv - self.net_io_start.packets_recv,
-                'errin': net_io.errin,
-                'errout': net_io.errout
-            })
-            
-            # Disk I/O monitoring
-            disk_io = psutil.disk_io_counters()
-            
-            self.disk_data.append({
-                'timestamp': timestamp,
-                'read_bytes': disk_io.read_bytes - self.disk_io_start.read_bytes,
-                'write_bytes': disk_io.write_bytes - self.disk_io_start.write_bytes,
-                'read_count': disk_io.read_count - self.disk_io_start.read_count,
-                'write_count': disk_io.write_count - self.disk_io_start.write_count
-            })
-            
-            time.sleep(self.interval)
+            done = time.perf_counter()
+            self.busy_seconds += done - now
+            wake = min(min(next_due.values()), next_flush) if next_due else next_flush
+            self._stop_event.wait(max(0.0, wake - done))
+        
+        for ring in self.rings.values():
+            ring.close()
+        self.elapsed_seconds = time.perf_counter() - start
+    
+    def _write_csv(self, path, metric, fieldnames, columns):
+        """Stream one metric's binary log into a CSV, a chunk at a time"""
+        with open(path, 'w', newline='') as f:
+            ring = self.rings.get(metric)
+            if ring is None or ring.path is None:
+                return
+            data = read_monitor_log(ring.path)
+            if len(data) == 0:
+                return
+            writer = csv.writer(f)
+            writer.writerow(fieldnames)
+            for first in range(0, len(data), CSV_CHUNK_ROWS):
+                chunk = data[first:first + CSV_CHUNK_ROWS]
+                writer.writerows(zip(*[column(chunk) for column in columns]))
     
     def save_logs(self, prefix="monitor"):
-        """Save monitoring data to files"""
+        """Convert the binary logs (as flushed so far) to CSV files and save the summary"""
         timestamp_str = datetime.now().strftime("%Y%m%d_%H%M%S")
         
-        # Save CPU data
+        def field(name):
+            return lambda chunk: chunk[name].tolist()
+        
+        def freq_at(chunk):
+            # Last frequency sample at or before each CPU sample
+            ring = self.rings.get('freq')
+            freq = read_monitor_log(ring.path, mmap=False) if ring and ring.path else []
+            if len(freq) == 0:
+                return [0.0] * len(chunk)
+            index = np.searchsorted(freq['timestamp'], chunk['timestamp'], side='right') - 1
+            return freq['cpu_freq_current'][np.maximum(index, 0)].tolist()
+        
         cpu_file = os.path.join(self.log_dir, f"{prefix}_cpu_{timestamp_str}.csv")
-        with open(cpu_file, 'w', newline='') as f:
-            if self.cpu_data:
-                writer = csv.DictWriter(f, fieldnames=['timestamp', 'cpu_percent_total', 
-                                                       'cpu_freq_current', 'num_cores'])
-                writer.writeheader()
-                for row in self.cpu_data:
-                    writer.writerow({
-                        'timestamp': row['timestamp'],
-                        'cpu_percent_total': row['cpu_percent_total'],
-                        'cpu_freq_current': row['cpu_freq_current'],
-                        'num_cores': row['num_cores']
-                    })
-        
-        # Save memory data
-        mem_file = os.path.join(self.log_dir, f"{prefix}_memory_{timestamp_str}.csv")
-        with open(mem_file, 'w', newline='') as f:
-            if self.memory_data:
-                writer = csv.DictWriter(f, fieldnames=self.memory_data[0].keys())
-                writer.writeheader()
-                writer.writerows(self.memory_data)
-        
-        # Save network data
-        net_file = os.path.join(self.log_dir, f"{prefix}_network_{timestamp_str}.csv")
-        with open(net_file, 'w', newline='') as f:
-            if self.network_data:
-                writer = csv.DictWriter(f, fieldnames=self.network_data[0].keys())
-                writer.writeheader()
-                writer.writerows(self.network_data)
-        
-        # Save disk data
-        disk_file = os.path.join(self.log_dir, f"{prefix}_disk_{timestamp_str}.csv")
-        with open(disk_file, 'w', newline='') as f:
-            if self.disk_data:
-                writer = csv.DictWriter(f, fieldnames=self.disk_data[0].keys())
-                writer.writeheader()
-                writer.writerows(self.disk_data)
+        self._write_csv(cpu_file, 'cpu',
+                        ['timestamp', 'cpu_percent_total', 'cpu_freq_current', 'num_cores'],
+                        [field('timestamp'), field('cpu_percent_total'), freq_at,
+                         lambda chunk: [self.num_cores] * len(chunk)])
+        
+        files = {'cpu': cpu_file}
+        for metric in ('memory', 'network', 'disk', 'ranks'):
+            path = os.path.join(self.log_dir, f"{prefix}_{metric}_{timestamp_str}.csv")
+            ring = self.rings.get(metric)
+            names = list(ring.dtype.names) if ring else []
+            self._write_csv(path, metric, names, [field(name) for name in names])
+            files[metric] = path
         
         # Save summary
         summary = self.get_summary()
         summary_file = os.path.join(self.log_dir, f"{prefix}_summary_{timestamp_str}.json")
         with open(summary_file, 'w') as f:
             json.dump(summary, f, indent=2)
+        files['summary'] = summary_file
+        files['binary'] = {metric: ring.path for metric, ring in self.rings.items()}
         
         print(f"[Monitor] Logs saved to {self.log_dir}")
-        return {
-            'cpu': cpu_file,
-            'memory': mem_file,
-            'network': net_file,
-            'disk': disk_file,
-            'summary': summary_file
-        }
+        return files
     
     def get_summary(self):
-        """Generate summary statistics"""
+        """Generate summary statistics (from running aggregates, O(1) memory)"""
+        cpu = self.rings.get('cpu')
         summary = {
             'timestamp': datetime.now().isoformat(),
-            'duration_seconds': self.cpu_data[-1]['timestamp'] if self.cpu_data else 0,
-            'samples_collected': len(self.cpu_data)
+            'duration_seconds': float(cpu.last[0]) if cpu and cpu.last else 0,
+            'samples_collected': cpu.count if cpu else 0
         }
         
         # CPU summary
-        if self.cpu_data:
-            cpu_percents = [d['cpu_percent_total'] for d in self.cpu_data]
+        if cpu and cpu.count:
+            stat = cpu.stats['cpu_percent_total']
             summary['cpu'] = {
-                'avg_percent': sum(cpu_percents) / len(cpu_percents),
-                'max_percent': max(cpu_percents),
-                'min_percent': min(cpu_percents),
-                'num_cores': self.cpu_data[0]['num_cores']
+                'avg_percent': cpu.mean('cpu_percent_total'),
+                'max_percent': float(stat[2]),
+                'min_percent': float(stat[1]),
+                'num_cores': self.num_cores
             }
         
         # Memory summary
-        if self.memory_data:
-            mem_percents = [d['percent'] for d in self.memory_data]
-            mem_used = [d['used_mb'] for d in self.memory_data]
+        memory = self.rings.get('memory')
+        if memory and memory.count:
             summary['memory'] = {
-                'avg_percent': sum(mem_percents) / len(mem_percents),
-                'max_percent': max(mem_percents),
-                'peak_used_mb': max(mem_used),
-                'total_mb': self.memory_data[0]['total_mb']
+                'avg_percent': memory.mean('percent'),
+                'max_percent': float(memory.stats['percent'][2]),
+                'peak_used_mb': float(memory.stats['used_mb'][2]),
+                'total_mb': float(memory.last[1])
             }
         
         # Network summary
-        if self.network_data:
+        network = self.rings.get('network')
+        if network and network.count:
+            last = network.last
             summary['network'] = {
-                'total_sent_mb': self.network_data[-1]['bytes_sent'] / (1024**2),
-                'total_recv_mb': self.network_data[-1]['bytes_recv'] / (1024**2),
-                'total_packets_sent': self.network_data[-1]['packets_sent'],
-                'total_packets_recv': self.network_data[-1]['packets_recv']
+                'total_sent_mb': last[1] / (1024**2),
+                'total_recv_mb': last[2] / (1024**2),
+                'total_packets_sent': last[3],
+                'total_packets_recv': last[4]
             }
         
         # Disk summary
-        if self.disk_data:
+        disk = self.rings.get('disk')
+        if disk and disk.count:
+            last = disk.last
             summary['disk'] = {
-                'total_read_mb': self.disk_data[-1]['read_bytes'] / (1024**2),
-                'total_write_mb': self.disk_data[-1]['write_bytes'] / (1024**2),
-                'total_read_ops': self.disk_data[-1]['read_count'],
-                'total_write_ops': self.disk_data[-1]['write_count']
+                'total_read_mb': last[1] / (1024**2),
+                'total_write_mb': last[2] / (1024**2),
+                'total_read_ops': last[3],
+                'total_write_ops': last[4]
             }
         
+        # What the monitor itself cost
+        summary['sampling'] = {
+            metric: {'rate_hz': ring.rate, 'samples': ring.count, 'dropped': ring.dropped}
+            for metric, ring in self.rings.items()
+        }
+        if self.elapsed_seconds > 0:
+            summary['monitor_busy_percent'] = 100.0 * self.busy_seconds / self.elapsed_seconds
+        
+        # Our job's own processes
+        processes = self.get_rank_attribution()
+        if processes is not None:
+            summary['processes'] = processes
+        
         return summary
     
+    def get_rank_attribution(self):
+        """Per-rank/per-node usage (see attribute_rank_samples), None without rank samples"""
+        ring = self.rings.get('ranks')
+        if ring is None or ring.path is None or ring.count == 0:
+            return None
+        phases = read_phase_log(self.phase_log, self.start_wall) if self.phase_log else []
+        return attribute_rank_samples(read_monitor_log(ring.path), phases)
+    
     def print_summary(self):
         """Print summary to console"""
         summary = self.get_summary()
@@ -226,6 +712,8 @@ class ResourceMonitor:
         print("="*60)
         print(f"Duration: {summary['duration_seconds']:.2f} seconds")
         print(f"Samples: {summary['samples_collected']}")
+        if 'monitor_busy_percent' in summary:
+            print(f"Monitor Busy: {summary['monitor_busy_percent']:.3f}% of one core")
         
         if 'cpu' in summary:
             print(f"\nCPU:")
@@ -254,6 +742,25 @@ class ResourceMonitor:
             print(f"  Read Ops: {summary['disk']['total_read_ops']}")
             print(f"  Write Ops: {summary['disk']['total_write_ops']}")
         
+        if summary.get('processes', {}).get('ranks'):
+            processes = summary['processes']
+            print(f"\nMPI Ranks on {processes['node']}:")
+            print(f"  {'Rank':<6}{'PID':<9}{'CPU (s)':<10}{'CPU %':<9}{'Peak RSS (MB)':<15}"
+                  f"{'Faults (maj)':<14}{'Ctx (invol)':<12}")
+            for rank, usage in sorted(processes['ranks'].items()):
+                print(f"  {rank:<6}{usage['pid']:<9}{usage['cpu_seconds']:<10.2f}"
+                      f"{usage['cpu_percent']:<9.1f}{usage['peak_rss_mb']:<15.1f}"
+                      f"{usage['major_faults']:<14.0f}{usage['ctx_involuntary']:<12.0f}")
+            node = processes['node_total']
+            print(f"  Node: {node['cpu_seconds']:.2f} CPU s, peak RSS {node['peak_rss_mb']:.1f} MB, "
+                  f"I/O {node['read_bytes'] / (1024**2):.2f} MB read / "
+                  f"{node['write_bytes'] / (1024**2):.2f} MB written")
+            for operation, phase in processes['phases'].items():
+                node = phase['node_total']
+                print(f"  Phase {operation}: {phase['end'] - phase['begin']:.3f} s, "
+                      f"{node['cpu_seconds']:.2f} CPU s over {node['ranks']} ranks, "
+                      f"peak RSS {node['peak_rss_mb']:.1f} MB")
+        
         print("="*60)
 
 